@@ -0,0 +1,29 @@
+#!/bin/bash
+# Measure every engine on the boards in Data/in (or random boards) with warmup and repeated trials.
+# Writes median and p95 cell updates per second as CSV (or JSON if REPORT ends with .json).
+#
+# Settings (environment):
+#   EXE          GameOfLife binary (default ./GameOfLife)
+#   BOARDS       comma separated files or <width>x<height> random boards (default all of Data/in)
+#   MODES        comma separated modes (default seq,omp,bit,simd,lut,tiled,bands)
+#   THREADS      thread counts for omp, tiled, bands and sparse (default 1 and all cores)
+#   GENERATIONS  generations per run (default 100)
+#   TRIALS       measured runs (default 5), WARMUP unmeasured runs before (default 1)
+#   SEED         seed of the random boards (default 1)
+#   REPORT       output file (default benchmark_<host>_<date>.csv)
+
+EXE="${EXE:-./GameOfLife}"
+INPUT="Data/in"
+BOARDS="${BOARDS:-$(ls "$INPUT"/*.gol | sort -V | paste -sd, -)}"
+MODES="${MODES:-seq,omp,bit,simd,lut,tiled,bands}"
+THREADS="${THREADS:-1,$(nproc)}"
+GENERATIONS="${GENERATIONS:-100}"
+TRIALS="${TRIALS:-5}"
+WARMUP="${WARMUP:-1}"
+SEED="${SEED:-1}"
+REPORT="${REPORT:-benchmark_$(hostname)_$(date +%Y%m%d_%H%M%S).csv}"
+
+echo "Benchmarking $MODES on $BOARDS"
+"$EXE" --benchmark "$REPORT" --bench-boards "$BOARDS" --bench-modes "$MODES" --bench-threads "$THREADS" \
+    --bench-trials "$TRIALS" --bench-warmup "$WARMUP" --bench-seed "$SEED" --generations "$GENERATIONS" || exit 1
+echo "Results written to '$REPORT'"
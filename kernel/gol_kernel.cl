@@ -1,9 +1,19 @@
-__constant bool RULE_TABLE[2][9] = { {0,0,0,1,0,0,0,0,0},{0,0,1,1,0,0,0,0,0} };
+// Rule, set by the host at build time: bit n of BIRTH (SURVIVAL) is set if a dead (alive) cell with n alive neighbors lives.
+#ifndef BIRTH
+#define BIRTH 0x008
+#define SURVIVAL 0x00C
+#endif
+#define NEXT_STATE(alive, neighbors) (((((alive) ? SURVIVAL : BIRTH) >> (neighbors)) & 1) != 0)
+
+// dimensions: width, height, stride (cells per row including halo and padding), offset (index of cell 0,0),
+// size (cells per board including halo and padding). Batches keep boards one after the other,
+// the second work-item dimension is the board (0 for single boards).
 
 __kernel void process_cell(__global const bool* world, __global bool* newWorld, __global const int* dimensions) {
 
     int width = dimensions[0];
-    int height = dimensions[1];
+    int stride = dimensions[2];
+    int offset = dimensions[3] + dimensions[4] * (int)get_global_id(1);
 
     // Get index of current element
     int ID = get_global_id(0);
@@ -12,26 +22,101 @@ __kernel void process_cell(__global const bool* world, __global bool* newWorld,
     // Get indices
     int x = ID % width;
     int y = ID / width;
+    int i = offset + y * stride + x;
+
+    // Halo is refreshed, no wrap around needed
+    unsigned int neighborsAlive =
+        world[i - stride - 1] + world[i - stride] + world[i - stride + 1] +
+        world[i - 1] + world[i + 1] +
+        world[i + stride - 1] + world[i + stride] + world[i + stride + 1];
+
+    // Apply gol-rules
+    newWorld[i] = NEXT_STATE(world[i], neighborsAlive);
+}
+
+// Copy last column into left halo and first column into right halo
+__kernel void wrap_columns(__global bool* world, __global const int* dimensions) {
+
+    int width = dimensions[0];
+    int stride = dimensions[2];
+    int offset = dimensions[3] + dimensions[4] * (int)get_global_id(1);
+
+    int row = offset + get_global_id(0) * stride;
+    world[row - 1] = world[row + width - 1];
+    world[row + width] = world[row];
+}
+
+// Copy last row into top halo and first row into bottom halo (width + 2 items, so corners are included)
+__kernel void wrap_rows(__global bool* world, __global const int* dimensions) {
+
+    int height = dimensions[1];
+    int stride = dimensions[2];
+    int offset = dimensions[3] + dimensions[4] * (int)get_global_id(1);
+
+    int x = (int)get_global_id(0) - 1;
+    world[offset - stride + x] = world[offset + (height - 1) * stride + x];
+    world[offset + height * stride + x] = world[offset + x];
+}
 
-    unsigned int neighborsAlive = 0;
-    for (int yOffset = -1; yOffset <= 1; yOffset++)
+// 2D variant: every work-group loads its tile plus a halo of depth cells into local memory
+// and advances it depth generations there (the valid area shrinks by one cell per generation).
+// Reads wrap around with modulo, so the grid halo is not needed.
+// current and next hold (group width + 2 * depth) * (group height + 2 * depth) cells each.
+__kernel void process_tile(__global const bool* world, __global bool* newWorld, __global const int* dimensions,
+    const int depth, __local uchar* current, __local uchar* next) {
+
+    int width = dimensions[0];
+    int height = dimensions[1];
+    int stride = dimensions[2];
+    int offset = dimensions[3];
+
+    int groupWidth = get_local_size(0);
+    int groupHeight = get_local_size(1);
+    int localX = get_local_id(0);
+    int localY = get_local_id(1);
+    int localWidth = groupWidth + 2 * depth;
+    int localHeight = groupHeight + 2 * depth;
+
+    // Top left cell of the local tile (including halo)
+    int tileX = get_group_id(0) * groupWidth - depth;
+    int tileY = get_group_id(1) * groupHeight - depth;
+
+    // Load tile and halo (wrap around)
+    for (int ly = localY; ly < localHeight; ly += groupHeight)
     {
-        for (int xOffset = -1; xOffset <= 1; xOffset++)
+        int y = ((tileY + ly) % height + height) % height;
+        for (int lx = localX; lx < localWidth; lx += groupWidth)
         {
-            // Skip self
-            if (yOffset == 0 && xOffset == 0)
-                continue;
-            // Wrap around.
-            int currentX = x + xOffset;
-            currentX = currentX == width ? 0 : currentX < 0 ? width - 1 : currentX;
-            int currentY = y + yOffset;
-            currentY = currentY == height ? 0 : currentY < 0 ? height - 1 : currentY;
-
-            if (world[(currentY * width) + currentX])
-                neighborsAlive++;
+            int x = ((tileX + lx) % width + width) % width;
+            current[ly * localWidth + lx] = world[offset + y * stride + x];
         }
     }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-    // Apply gol-rules
-    newWorld[ID] = RULE_TABLE[world[ID]][neighborsAlive];
-}
\ No newline at end of file
+    for (int step = 1; step <= depth; step++)
+    {
+        for (int ly = step + localY; ly < localHeight - step; ly += groupHeight)
+        {
+            for (int lx = step + localX; lx < localWidth - step; lx += groupWidth)
+            {
+                int i = ly * localWidth + lx;
+                unsigned int neighborsAlive =
+                    current[i - localWidth - 1] + current[i - localWidth] + current[i - localWidth + 1] +
+                    current[i - 1] + current[i + 1] +
+                    current[i + localWidth - 1] + current[i + localWidth] + current[i + localWidth + 1];
+                next[i] = NEXT_STATE(current[i], neighborsAlive);
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        __local uchar* temp = current;
+        current = next;
+        next = temp;
+    }
+
+    // Write back own cell (NDRange is rounded up to the group size)
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if (x < width && y < height)
+        newWorld[offset + y * stride + x] = current[(localY + depth) * localWidth + localX + depth];
+}
@@ -1,37 +1,84 @@
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
 #include <map>
+#include <sstream>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <thread>
 
 #include "util/Timing.h"
+#include "src/Grid.h"
+#include "src/GOLFile.h"
 #include "src/GOLSingleThread.h"
 #include "src/GOLOpenMP.h"
 #include "src/GOLOpenCL.h"
-
-#define ALIVE 'x'
-#define DEAD '.'
+#include "src/GOLBitPacked.h"
+#include "src/GOLSimd.h"
+#include "src/GOLHashLife.h"
+#include "src/GOLSparse.h"
+#include "src/GOLMPI.h"
+#include "src/GOLWorkStealing.h"
+#include "src/GOLLookup.h"
+#include "src/GOLServer.h"
+#include "src/TuningProfile.h"
+#include "src/SnapshotWriter.h"
+#include "src/Benchmark.h"
+#include "src/CycleDetector.h"
+#include "src/Rule.h"
 
 enum class ArgumentType
 {
-	LOAD, SAVE, GENERATIONS, MEASURE, PRETTY, MODE, THREADS, HELP
+	LOAD, SAVE, LOAD_FORMAT, SAVE_FORMAT, GENERATIONS, MEASURE, PRETTY, MODE, THREADS, TILE_SIZE, TILE_DEPTH, WORK_GROUP, OCL_DEPTH, CL_PLATFORM, CL_DEVICE, NODE_LIMIT, ACTIVE_TILES, WINDOW, SNAPSHOT_EVERY, SNAPSHOT,
+	BENCHMARK, BENCH_BOARDS, BENCH_MODES, BENCH_THREADS, BENCH_TRIALS, BENCH_WARMUP, BENCH_SEED, PERF, TIMING_JSON, DETECT_CYCLES, RULE, MPI_GRID, HALO_DEPTH, BATCH, SERVE, AUTOTUNE, PROFILE, HELP
 };
 
 
 std::map<std::string, ArgumentType> argumentMap{
 	{"--load", ArgumentType::LOAD},
 	{"--save", ArgumentType::SAVE},
+	{"--load-format", ArgumentType::LOAD_FORMAT},
+	{"--save-format", ArgumentType::SAVE_FORMAT},
 	{"--generations", ArgumentType::GENERATIONS},
 	{"--measure", ArgumentType::MEASURE},
 	{"--pretty", ArgumentType::PRETTY},
 	{"--mode", ArgumentType::MODE},
 	{"--threads", ArgumentType::THREADS},
+	{"--tile-size", ArgumentType::TILE_SIZE},
+	{"--tile-depth", ArgumentType::TILE_DEPTH},
+	{"--work-group", ArgumentType::WORK_GROUP},
+	{"--ocl-depth", ArgumentType::OCL_DEPTH},
+	{"--cl-platform", ArgumentType::CL_PLATFORM},
+	{"--cl-device", ArgumentType::CL_DEVICE},
+	{"--node-limit", ArgumentType::NODE_LIMIT},
+	{"--active-tiles", ArgumentType::ACTIVE_TILES},
+	{"--window", ArgumentType::WINDOW},
+	{"--snapshot-every", ArgumentType::SNAPSHOT_EVERY},
+	{"--snapshot", ArgumentType::SNAPSHOT},
+	{"--benchmark", ArgumentType::BENCHMARK},
+	{"--bench-boards", ArgumentType::BENCH_BOARDS},
+	{"--bench-modes", ArgumentType::BENCH_MODES},
+	{"--bench-threads", ArgumentType::BENCH_THREADS},
+	{"--bench-trials", ArgumentType::BENCH_TRIALS},
+	{"--bench-warmup", ArgumentType::BENCH_WARMUP},
+	{"--bench-seed", ArgumentType::BENCH_SEED},
+	{"--perf", ArgumentType::PERF},
+	{"--timing-json", ArgumentType::TIMING_JSON},
+	{"--detect-cycles", ArgumentType::DETECT_CYCLES},
+	{"--rule", ArgumentType::RULE},
+	{"--mpi-grid", ArgumentType::MPI_GRID},
+	{"--halo-depth", ArgumentType::HALO_DEPTH},
+	{"--batch", ArgumentType::BATCH},
+	{"--serve", ArgumentType::SERVE},
+	{"--autotune", ArgumentType::AUTOTUNE},
+	{"--profile", ArgumentType::PROFILE},
 	{"--help", ArgumentType::HELP},
 };
 
 enum class ModeType
 {
-	SEQ, OMP, OCL
+	SEQ, OMP, OCL, BIT, SIMD, TILED, BANDS, OCL_TILED, HASHLIFE, SPARSE, MPI, STEAL, LUT, AUTO
 };
 
 
@@ -39,100 +86,327 @@ std::map<std::string, ModeType> modeMap{
 	{"seq", ModeType::SEQ},
 	{"omp", ModeType::OMP},
 	{"ocl", ModeType::OCL},
+	{"bit", ModeType::BIT},
+	{"simd", ModeType::SIMD},
+	{"tiled", ModeType::TILED},
+	{"bands", ModeType::BANDS},
+	{"ocltiled", ModeType::OCL_TILED},
+	{"hashlife", ModeType::HASHLIFE},
+	{"sparse", ModeType::SPARSE},
+	{"mpi", ModeType::MPI},
+	{"steal", ModeType::STEAL},
+	{"lut", ModeType::LUT},
+	{"auto", ModeType::AUTO},
 };
 
 std::map<ModeType, std::string> modeNameMap{
 	{ModeType::SEQ, "Sequential"},
 	{ModeType::OMP, "OpenMP"},
 	{ModeType::OCL, "OpenCL"},
+	{ModeType::BIT, "BitPacked"},
+	{ModeType::SIMD, "SIMD"},
+	{ModeType::TILED, "OpenMP Tiled"},
+	{ModeType::BANDS, "OpenMP Bands"},
+	{ModeType::OCL_TILED, "OpenCL Tiled"},
+	{ModeType::HASHLIFE, "HashLife"},
+	{ModeType::SPARSE, "Sparse"},
+	{ModeType::MPI, "MPI"},
+	{ModeType::STEAL, "Work Stealing"},
+	{ModeType::LUT, "Lookup Table"},
+	{ModeType::AUTO, "Auto"},
 };
 
 std::string InputFile = "random10000_in.gol";
 std::string OutputFile = "out.gol";
+GOLFile::Format inputFormat = GOLFile::Format::AUTO;
+GOLFile::Format outputFormat = GOLFile::Format::AUTO;
 
 unsigned int generations = 250;
 bool showMeasurements = false;
 bool prettyPrint = false;
+bool hardwareCounters = false;
+std::string timingFile;
 
 ModeType mode = ModeType::SEQ;
+// --rule overrides the rule of an RLE file.
+bool ruleSet = false;
 
 unsigned int numberOfThreads = 0;
+unsigned int tileSize = 256;
+unsigned int tileDepth = 8;
+unsigned int workGroupWidth = 16;
+unsigned int workGroupHeight = 16;
+unsigned int oclDepth = 4;
+unsigned int clPlatform = 0;
+unsigned int clDevice = 0;
+size_t nodeLimit = 4000000;
+unsigned int activeTileSize = 0;
+unsigned int snapshotEvery = 0;
+std::string snapshotPattern = "snapshot_{generation}.gol";
+// 0 picks the layout from the number of ranks.
+int mpiColumns = 0;
+int mpiRows = 0;
+unsigned int haloDepth = 1;
+std::string batchFile;
+std::string serveSocket;
+std::string autotuneBoard;
+// Empty for the profile of this host.
+std::string profileFile;
 
+std::string benchReport;
+std::vector<std::string> benchBoards{ "500x500", "1000x1000", "2000x2000", "4000x4000" };
+std::vector<std::string> benchModes{ "seq", "omp", "bit", "simd", "lut", "tiled", "bands" };
+std::vector<unsigned int> benchThreads{ 1, std::max(1u, std::thread::hardware_concurrency()) };
+unsigned int benchTrials = 5;
+unsigned int benchWarmup = 1;
+unsigned int benchSeed = 1;
+
+bool checkRule();
+void setupMode(Grid* world, Grid* newWorld);
+Grid* runMode(Grid* world, Grid* newWorld, unsigned int generations);
+int runBenchmark();
+int runDistributed(int argc, char* argv[]);
+int runBatch();
+int runAutotune();
+bool applyProfile(unsigned int width, unsigned int height);
+Grid* loadBoard(const std::string& board, std::string& name);
 void processArgs(int argc, char* argv[]);
 void showWrongArgs();
 void showHelp();
+std::vector<std::string> splitList(const std::string& list);
 
 int main(int argc, char* argv[])
 {
 	// Handle arguments.
 	processArgs(argc, argv);
+	GOLOpenCL::selectDevice(clPlatform, clDevice);
 	Timing* time = Timing::getInstance();
 
+	// Before any thread is started, only later threads are counted.
+	if (hardwareCounters && !time->enableHardwareCounters())
+		std::cerr << "Hardware counters are not available (perf_event_open)." << std::endl;
+
+	if (!benchReport.empty())
+		return runBenchmark();
+
+	if (!batchFile.empty())
+		return runBatch();
+
+	if (!autotuneBoard.empty())
+		return runAutotune();
+
+	if (!serveSocket.empty())
+		return GOLServer::run(serveSocket, activeTileSize);
+
+	// hashlife, sparse and mpi keep their own board between calls and cannot stop in between.
+	if (snapshotEvery > 0 && (mode == ModeType::HASHLIFE || mode == ModeType::SPARSE || mode == ModeType::MPI))
+	{
+		std::cerr << "--snapshot-every is not supported by " << modeNameMap[mode] << " mode." << std::endl;
+		return 1;
+	}
+
+	if (mode == ModeType::MPI)
+		return runDistributed(argc, argv);
+
 	//----------------------------------------------------------------------------------------------------
 	// SETUP
 	//----------------------------------------------------------------------------------------------------
 	time->startSetup();
 
-	// Read file.
-	std::ifstream input;
-	input.open(InputFile);
-	if (!input.is_open())
+	// Map file.
+	GOLFile input;
+	if (!input.open(InputFile, inputFormat))
 	{
-		std::cerr << "COULD NOT OPEN INPUT-FILE. WRONG PATH?" << std::endl;
+		std::cerr << input.getError() << std::endl;
 		return 1;
 	}
 
+	// Rule of the file, unless given as argument.
+	if (!ruleSet && input.hasRule())
+		Rule::setActive(input.getRule());
+
 	// Get board size.
-	std::string columns, rows;
-	std::getline(input, columns, ',');
-	std::getline(input, rows);
-	unsigned int width = std::stoi(columns);
-	unsigned int height = std::stoi(rows);
-	unsigned int worldSize = width * height;
+	unsigned int width = input.getWidth();
+	unsigned int height = input.getHeight();
 
-	bool** world = new bool* [height];
-	bool** newWorld = new bool* [height];
-	for (unsigned int i = 0; i < height; i++)
-	{
-		world[i] = new bool[width];
-		newWorld[i] = new bool[width];
-	}
+	// Engine and settings for this size from the autotune profile.
+	if (mode == ModeType::AUTO && !applyProfile(width, height))
+		return 1;
+	if (!checkRule())
+		return 1;
 
-	// Convert file to bool-array.
-	for (unsigned int y = 0; y < height; y++)
+	Grid* world = new Grid(width, height);
+	Grid* newWorld = new Grid(width, height);
+
+	// Convert file to grid (the bit-packed engine reads it into its own layout).
+	bool valid = mode == ModeType::BIT ? GOLBitPacked::setup(input) : input.readInto(world);
+	if (!valid)
 	{
-		std::string line;
-		std::getline(input, line);
-		for (unsigned int x = 0; x < width; x++)
-			world[y][x] = line[x] == ALIVE;
+		std::cerr << input.getError() << std::endl;
+		return 1;
 	}
 	input.close();
 
-	if (mode == ModeType::OMP)
-		GOLOpenMP::setup(numberOfThreads);
-
-	if (mode == ModeType::OCL)
-		GOLOpenCL::setup(world, newWorld, width, height);
+	// The bit-packed engine is already set up from the file.
+	if (mode != ModeType::BIT)
+		setupMode(world, newWorld);
 
 	time->stopSetup();
 	//----------------------------------------------------------------------------------------------------
 	// Calculation
 	//----------------------------------------------------------------------------------------------------
 	time->startComputation();
-	bool** result;
-	// Go through all generations.
+	Grid* result;
+	if (snapshotEvery == 0)
+	{
+		// Go through all generations.
+		result = runMode(world, newWorld, generations);
+	}
+	else
+	{
+		// Stop every snapshotEvery generations, copy the board and let the writer save it while computing on.
+		SnapshotWriter snapshots(width, height, snapshotPattern);
+		unsigned int done = 0;
+		result = world;
+		do
+		{
+			unsigned int step = std::min(snapshotEvery, generations - done);
+			result = runMode(result, result == world ? newWorld : world, step);
+			done += step;
+			if (done < generations)
+				snapshots.capture(result, done);
+		} while (done < generations);
+
+		if (!snapshots.finish())
+		{
+			std::cerr << "COULD NOT WRITE SNAPSHOT " << snapshots.getFailedPath() << std::endl;
+			return 1;
+		}
+		time->addRecord("snapshot capture", snapshots.getCaptureTime());
+		time->addRecord("snapshot write (background)", snapshots.getWriteTime());
+		time->setCounter("snapshots", snapshots.getCount());
+	}
+
+	time->stopComputation();
+	//----------------------------------------------------------------------------------------------------
+	// Output
+	//----------------------------------------------------------------------------------------------------
+	time->startFinalization();
 
+	// Write result to file (sparse mode exports a window of any size).
+	if (!GOLFile::save(OutputFile, result, outputFormat))
+	{
+		std::cerr << "COULD NOT WRITE OUTPUT-FILE." << std::endl;
+		return 1;
+	}
+	time->stopFinalization();
+
+	if (prettyPrint)
+		time->print(true);
+
+	if (showMeasurements)
+		std::cout << time->getResults() << std::endl;
+
+	if (!timingFile.empty())
+	{
+		std::ofstream timing(timingFile, std::ios::out | std::ios::trunc);
+		time->writeJSON(timing);
+	}
+
+	return 0;
+}
+
+
+/**
+ * simd, bit and sparse compute B3/S23 with bit logic instead of a rule table.
+ * hashlife and sparse need empty space to stay empty (no birth without neighbors).
+ */
+bool checkRule()
+{
+	const Rule& rule = Rule::getActive();
+	bool supported = true;
+	if (mode == ModeType::SIMD || mode == ModeType::BIT || mode == ModeType::SPARSE)
+		supported = rule.isConway();
+	if (mode == ModeType::HASHLIFE)
+		supported = !rule.bornFromNothing();
+	if (!supported)
+		std::cerr << "The rule " << rule.toString() << " is not supported by " << modeNameMap[mode] << " mode." << std::endl;
+	return supported;
+}
+
+void setupMode(Grid* world, Grid* newWorld)
+{
+	if (mode == ModeType::OMP || mode == ModeType::TILED || mode == ModeType::BANDS || mode == ModeType::SPARSE || mode == ModeType::STEAL)
+		GOLOpenMP::setup(numberOfThreads);
+
+	if (mode == ModeType::OCL || mode == ModeType::OCL_TILED)
+		GOLOpenCL::setup(world, newWorld);
+
+	if (mode == ModeType::BIT)
+		GOLBitPacked::setup(world);
+
+	if (mode == ModeType::SIMD)
+		GOLSimd::setup();
+
+	if (mode == ModeType::HASHLIFE)
+		GOLHashLife::setup(world, nodeLimit);
+
+	if (mode == ModeType::SPARSE)
+		GOLSparse::setup(world);
+
+	if (mode == ModeType::STEAL)
+		GOLWorkStealing::setup(world, tileSize);
+
+	if (mode == ModeType::LUT)
+		GOLLookup::setup(world);
+}
+
+Grid* runMode(Grid* world, Grid* newWorld, unsigned int generations)
+{
+	Grid* result;
 	switch (mode)
 	{
 	case ModeType::SEQ:
-		result = GOLSingleThread::runGenerations(world, newWorld, width, height, generations);
+		if (activeTileSize > 0)
+			result = GOLSingleThread::runGenerationsActive(world, newWorld, generations, activeTileSize);
+		else
+			result = GOLSingleThread::runGenerations(world, newWorld, generations);
 		break;
 	case ModeType::OMP:
-		result = GOLOpenMP::runGenerations(world, newWorld, width, height, generations);
-		break;
+		if (activeTileSize > 0)
+			result = GOLOpenMP::runGenerationsActive(world, newWorld, generations, activeTileSize);
+		else
+			result = GOLOpenMP::runGenerations(world, newWorld, generations);
 		break;
 	case ModeType::OCL:
-		result = GOLOpenCL::runGenerations(world, newWorld, width, height, generations);
+		result = GOLOpenCL::runGenerations(world, newWorld, generations);
+		break;
+	case ModeType::BIT:
+		result = GOLBitPacked::runGenerations(world, newWorld, generations);
+		break;
+	case ModeType::SIMD:
+		result = GOLSimd::runGenerations(world, newWorld, generations);
+		break;
+	case ModeType::TILED:
+		result = GOLOpenMP::runGenerationsTiled(world, newWorld, generations, tileSize, tileDepth);
+		break;
+	case ModeType::BANDS:
+		result = GOLOpenMP::runGenerationsPersistent(world, newWorld, generations);
+		break;
+	case ModeType::OCL_TILED:
+		result = GOLOpenCL::runGenerationsTiled(world, newWorld, generations, workGroupWidth, workGroupHeight, oclDepth);
+		break;
+	case ModeType::HASHLIFE:
+		result = GOLHashLife::runGenerations(world, newWorld, generations);
+		break;
+	case ModeType::SPARSE:
+		result = GOLSparse::runGenerations(world, newWorld, generations);
+		break;
+	case ModeType::STEAL:
+		result = GOLWorkStealing::runGenerations(world, newWorld, generations);
+		break;
+	case ModeType::LUT:
+		result = GOLLookup::runGenerations(world, newWorld, generations);
 		break;
 	default:
 		result = world;
@@ -140,37 +414,509 @@ int main(int argc, char* argv[])
 		break;
 	}
 
-	time->stopComputation();
-	//----------------------------------------------------------------------------------------------------
-	// Output
-	//----------------------------------------------------------------------------------------------------
-	time->startFinalization();
+	return result;
+}
 
-	// Write result to file.
-	std::ofstream output;
-	output.open(OutputFile, std::ios::out | std::ios::trunc);
-	output << width << "," << height << std::endl;
-	for (unsigned int y = 0; y < height; y++)
+/**
+ * Board of --bench-boards and --autotune: a file or "<width>x<height>" for a random board (benchSeed).
+ * name identifies it in reports; nullptr if the file cannot be read.
+ */
+Grid* loadBoard(const std::string& board, std::string& name)
+{
+	Grid* world;
+	name = board;
+	unsigned int width, height;
+	char separator;
+	std::istringstream size(board);
+	if (size >> width >> separator >> height && separator == 'x' && size.eof() && width > 0 && height > 0)
 	{
-		for (unsigned int x = 0; x < width; x++)
+		world = new Grid(width, height);
+		std::mt19937 random(benchSeed);
+		for (unsigned int y = 0; y < height; y++)
 		{
-			char alive = result[y][x] ? ALIVE : DEAD;
-			output << alive;
+			bool* row = world->getRow(y);
+			for (unsigned int x = 0; x < width; x++)
+				row[x] = random() & 1;
 		}
-		output << std::endl;
+		name = "random:" + board + ":" + std::to_string(benchSeed);
 	}
-	output.close();
-	time->stopFinalization();
+	else
+	{
+		GOLFile input;
+		if (!input.open(board))
+		{
+			std::cerr << board << ": " << input.getError() << std::endl;
+			return nullptr;
+		}
+		world = new Grid(input.getWidth(), input.getHeight());
+		if (!input.readInto(world))
+		{
+			std::cerr << board << ": " << input.getError() << std::endl;
+			delete world;
+			return nullptr;
+		}
+	}
+	return world;
+}
+
+/**
+ * Every mode in benchModes on every board in benchBoards, OpenMP modes with every count in benchThreads.
+ * Boards are files or "<width>x<height>" for a random board (benchSeed).
+ */
+int runBenchmark()
+{
+	Benchmark benchmark(generations, benchWarmup, benchTrials);
+	for (const std::string& board : benchBoards)
+	{
+		std::string name;
+		Grid* world = loadBoard(board, name);
+		if (world == nullptr)
+			return 1;
+
+		for (const std::string& modeName : benchModes)
+		{
+			mode = modeMap[modeName];
+			if (!checkRule())
+				return 1;
+			bool usesThreads = mode == ModeType::OMP || mode == ModeType::TILED || mode == ModeType::BANDS || mode == ModeType::SPARSE || mode == ModeType::STEAL;
+			for (unsigned int threads : usesThreads ? benchThreads : std::vector<unsigned int>{ 1 })
+			{
+				numberOfThreads = threads;
+				benchmark.measure(modeName, threads, name, world, setupMode, runMode);
+			}
+		}
+		delete world;
+	}
+
+	// Report: JSON for .json files, otherwise CSV ("-" is stdout).
+	std::ofstream file;
+	if (benchReport != "-")
+	{
+		file.open(benchReport, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "COULD NOT WRITE BENCHMARK REPORT." << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& output = benchReport == "-" ? std::cout : file;
+	bool json = benchReport.size() >= 5 && benchReport.compare(benchReport.size() - 5, 5, ".json") == 0;
+	if (json)
+		benchmark.writeJSON(output);
+	else
+		benchmark.writeCSV(output);
+	return 0;
+}
+
+/**
+ * Short runs of every engine that wraps around (not hashlife, sparse and mpi) on autotuneBoard: first each with every
+ * thread count, then tile settings with the best thread count. The fastest is stored in the profile for its size and rule.
+ */
+int runAutotune()
+{
+	std::string name;
+	Grid* world = loadBoard(autotuneBoard, name);
+	if (world == nullptr)
+		return 1;
+
+	// 1, powers of two and all cores.
+	const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	// Fixed length, so entries of different runs are comparable (and --generations 0 cannot divide by zero).
+	const unsigned int calibrationGenerations = 32;
+	Benchmark calibration(calibrationGenerations, 1, 3);
+	const Rule& rule = Rule::getActive();
+	TuningProfile::Entry best;
+	best.width = world->getWidth();
+	best.height = world->getHeight();
+	best.rule = rule.toString();
+
+	// Measures the current settings, returns milliseconds per generation.
+	auto measure = [&](const std::string& modeName)
+	{
+		mode = modeMap[modeName];
+		double milliseconds = calibration.measure(modeName, numberOfThreads, name, world, setupMode, runMode) * 1000 / calibrationGenerations;
+		if (best.mode.empty() || milliseconds < best.millisecondsPerGeneration)
+		{
+			best.mode = modeName;
+			best.threads = numberOfThreads;
+			best.tileSize = tileSize;
+			best.tileDepth = tileDepth;
+			best.workGroupWidth = workGroupWidth;
+			best.workGroupHeight = workGroupHeight;
+			best.oclDepth = oclDepth;
+			best.millisecondsPerGeneration = milliseconds;
+		}
+		return milliseconds;
+	};
+	const unsigned int defaultTileSize = tileSize;
+	const unsigned int defaultTileDepth = tileDepth;
+
+	numberOfThreads = 1;
+	std::vector<std::string> single{ "seq", "lut" };
+	if (rule.isConway())
+		single.insert(single.end(), { "bit", "simd" });
+	for (const std::string& modeName : single)
+		measure(modeName);
+
+	const std::vector<std::string> threaded{ "omp", "bands", "tiled", "steal" };
+	for (const std::string& modeName : threaded)
+	{
+		tileSize = defaultTileSize;
+		tileDepth = defaultTileDepth;
+		double fastest = 0;
+		unsigned int fastestThreads = 1;
+		for (unsigned int threads : threadCounts)
+		{
+			numberOfThreads = threads;
+			double milliseconds = measure(modeName);
+			if (threads == threadCounts[0] || milliseconds < fastest)
+			{
+				fastest = milliseconds;
+				fastestThreads = threads;
+			}
+		}
+
+		numberOfThreads = fastestThreads;
+		if (modeName == "tiled")
+		{
+			for (unsigned int size : { 64u, 128u, 256u, 512u })
+			{
+				for (unsigned int depth : { 2u, 4u, 8u, 16u })
+				{
+					tileSize = size;
+					tileDepth = depth;
+					measure(modeName);
+				}
+			}
+		}
+		if (modeName == "steal")
+		{
+			for (unsigned int size : { 32u, 64u, 128u, 256u, 512u })
+			{
+				tileSize = size;
+				measure(modeName);
+			}
+		}
+	}
+	tileSize = defaultTileSize;
+	tileDepth = defaultTileDepth;
+
+	if (GOLOpenCL::isAvailable())
+	{
+		numberOfThreads = 1;
+		measure("ocl");
+		for (unsigned int groupWidth : { 8u, 16u })
+		{
+			for (unsigned int groupHeight : { 8u, 16u })
+			{
+				for (unsigned int depth : { 1u, 2u, 4u, 8u })
+				{
+					workGroupWidth = groupWidth;
+					workGroupHeight = groupHeight;
+					oclDepth = depth;
+					measure("ocltiled");
+				}
+			}
+		}
+	}
+	delete world;
+
+	const std::string path = profileFile.empty() ? TuningProfile::defaultPath() : profileFile;
+	TuningProfile profile;
+	profile.load(path);
+	profile.store(best);
+	if (!profile.save(path))
+	{
+		std::cerr << "COULD NOT WRITE PROFILE " << path << std::endl;
+		return 1;
+	}
+	std::cout << best.width << "x" << best.height << " " << best.rule << ": " << best.mode << " --threads " << best.threads
+		<< " --tile-size " << best.tileSize << " --tile-depth " << best.tileDepth << " --work-group " << best.workGroupWidth << "x" << best.workGroupHeight
+		<< " --ocl-depth " << best.oclDepth << " (" << best.millisecondsPerGeneration << " ms per generation), saved to " << path << std::endl;
+	return 0;
+}
+
+/**
+ * --mode auto: mode and settings of the profile entry closest to this size (with the active rule).
+ */
+bool applyProfile(unsigned int width, unsigned int height)
+{
+	const std::string path = profileFile.empty() ? TuningProfile::defaultPath() : profileFile;
+	TuningProfile profile;
+	const std::string rule = Rule::getActive().toString();
+	const TuningProfile::Entry* entry = profile.load(path) ? profile.find(width, height, rule) : nullptr;
+	if (entry == nullptr)
+	{
+		std::cerr << "No autotune profile for " << rule << " in " << path << ", run --autotune first." << std::endl;
+		return false;
+	}
+	// Only modes the autotuner measures (the others do not wrap around or need several processes).
+	auto tuned = modeMap.find(entry->mode);
+	if (tuned == modeMap.end() || tuned->second == ModeType::AUTO || tuned->second == ModeType::HASHLIFE || tuned->second == ModeType::SPARSE || tuned->second == ModeType::MPI)
+	{
+		std::cerr << path << ": mode " << entry->mode << " cannot be used by --mode auto." << std::endl;
+		return false;
+	}
+	mode = tuned->second;
+	numberOfThreads = entry->threads;
+	tileSize = entry->tileSize > 0 ? entry->tileSize : tileSize;
+	tileDepth = entry->tileDepth > 0 ? entry->tileDepth : tileDepth;
+	workGroupWidth = entry->workGroupWidth > 0 ? entry->workGroupWidth : workGroupWidth;
+	workGroupHeight = entry->workGroupHeight > 0 ? entry->workGroupHeight : workGroupHeight;
+	oclDepth = entry->oclDepth > 0 ? entry->oclDepth : oclDepth;
+	return true;
+}
+
+/**
+ * Every line of batchFile is "<input> <output>" (# starts a comment); all boards get the same generations and rule.
+ * seq spreads whole boards over the threads, ocl computes consecutive boards of the same size in one launch.
+ * "<output>;<seconds>" is printed as soon as a board is saved, the throughput at the end.
+ */
+int runBatch()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	Timing* time = Timing::getInstance();
+	if (mode != ModeType::SEQ && mode != ModeType::OCL)
+	{
+		std::cerr << "--batch is not supported by " << modeNameMap[mode] << " mode (seq or ocl)." << std::endl;
+		return 1;
+	}
+
+	time->startSetup();
+	std::ifstream file(batchFile);
+	if (!file.is_open())
+	{
+		std::cerr << "COULD NOT OPEN BATCH-FILE." << std::endl;
+		return 1;
+	}
+	std::vector<std::pair<std::string, std::string>> jobs;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line.substr(0, line.find('#')));
+		std::string input, output;
+		if (!(fields >> input))
+			continue;
+		if (!(fields >> output))
+		{
+			std::cerr << batchFile << ": no output file for " << input << std::endl;
+			return 1;
+		}
+		jobs.emplace_back(input, output);
+	}
+	time->stopSetup();
 
+	// nullptr if the board cannot be read or asks for another rule.
+	auto load = [](const std::string& path) -> Grid*
+	{
+		GOLFile input;
+		if (!input.open(path, inputFormat))
+		{
+			std::cerr << path << ": " << input.getError() << std::endl;
+			return nullptr;
+		}
+		if (!ruleSet && input.hasRule() && input.getRule() != Rule::getActive())
+		{
+			std::cerr << path << ": rule " << input.getRule().toString() << " differs from the batch rule " << Rule::getActive().toString() << std::endl;
+			return nullptr;
+		}
+		Grid* world = new Grid(input.getWidth(), input.getHeight());
+		if (!input.readInto(world))
+		{
+			std::cerr << path << ": " << input.getError() << std::endl;
+			delete world;
+			return nullptr;
+		}
+		return world;
+	};
+	auto save = [](const std::string& path, const Grid* result, Clock::time_point start)
+	{
+		bool saved = GOLFile::save(path, result, outputFormat);
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+#pragma omp critical(batchOutput)
+		{
+			if (saved)
+				std::cout << path << ";" << seconds << std::endl;
+			else
+				std::cerr << path << ": COULD NOT WRITE OUTPUT-FILE." << std::endl;
+		}
+		return saved;
+	};
+
+	time->startComputation();
+	const Clock::time_point start = Clock::now();
+	long long failed = 0;
+	if (mode == ModeType::SEQ)
+	{
+		GOLOpenMP::setup(numberOfThreads);
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : failed)
+		for (int i = 0; i < (int)jobs.size(); i++)
+		{
+			Clock::time_point boardStart = Clock::now();
+			Grid* world = load(jobs[i].first);
+			if (world == nullptr)
+			{
+				failed++;
+				continue;
+			}
+			Grid newWorld(world->getWidth(), world->getHeight());
+			failed += !save(jobs[i].second, GOLSingleThread::runGenerations(world, &newWorld, generations), boardStart);
+			delete world;
+		}
+	}
+	else
+	{
+		// Boards of a launch, at most maxBatchSize cells (including halo and padding) in each of the two buffers.
+		const size_t maxBatchSize = (size_t)1 << 28;
+		std::vector<Grid*> batch;
+		std::vector<size_t> batchJobs;
+		size_t batchSize = 0;
+		Clock::time_point batchStart = Clock::now();
+		auto flush = [&]()
+		{
+			if (batch.empty())
+				return;
+			GOLOpenCL::runBatch(batch, generations);
+			for (size_t b = 0; b < batch.size(); b++)
+			{
+				failed += !save(jobs[batchJobs[b]].second, batch[b], batchStart);
+				delete batch[b];
+			}
+			batch.clear();
+			batchJobs.clear();
+			batchSize = 0;
+			batchStart = Clock::now();
+		};
+
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			Grid* world = load(jobs[i].first);
+			if (world == nullptr)
+			{
+				failed++;
+				continue;
+			}
+			if (!batch.empty() && (world->getWidth() != batch[0]->getWidth() || world->getHeight() != batch[0]->getHeight() || batchSize + world->getSize() > maxBatchSize))
+				flush();
+			batch.push_back(world);
+			batchJobs.push_back(i);
+			batchSize += world->getSize();
+		}
+		flush();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	time->stopComputation();
+
+	long long boards = (long long)jobs.size() - failed;
+	time->setCounter("boards", boards);
+	time->setCounter("failed boards", failed);
+	std::cout << boards << " boards in " << seconds << " s (" << (seconds > 0 ? boards / seconds : 0) << " boards/s)" << std::endl;
 	if (prettyPrint)
 		time->print(true);
-
 	if (showMeasurements)
 		std::cout << time->getResults() << std::endl;
+	if (!timingFile.empty())
+	{
+		std::ofstream timing(timingFile, std::ios::out | std::ios::trunc);
+		time->writeJSON(timing);
+	}
+	return failed == 0 ? 0 : 1;
+}
 
-	return 0;
+/**
+ * Every process runs this (e.g. mpirun -np 4). Rank 0 loads the board, hands out the blocks,
+ * collects the result and writes the output and measurements.
+ */
+int runDistributed(int argc, char* argv[])
+{
+#ifdef GOL_MPI
+	if (!GOLMPI::init(&argc, &argv))
+		return 1;
+	const bool root = GOLMPI::getRank() == 0;
+	Timing* time = Timing::getInstance();
+
+	time->startSetup();
+	Grid* world = nullptr;
+	if (root)
+	{
+		GOLFile input;
+		if (!input.open(InputFile, inputFormat))
+			std::cerr << input.getError() << std::endl;
+		else
+		{
+			if (!ruleSet && input.hasRule())
+				Rule::setActive(input.getRule());
+			world = new Grid(input.getWidth(), input.getHeight());
+			if (!input.readInto(world))
+			{
+				std::cerr << input.getError() << std::endl;
+				delete world;
+				world = nullptr;
+			}
+		}
+	}
+	// All ranks learn whether rank 0 could load the board.
+	if (!GOLMPI::setup(world, mpiColumns, mpiRows, haloDepth))
+	{
+		GOLMPI::finalize();
+		return 1;
+	}
+	time->stopSetup();
+
+	time->startComputation();
+	GOLMPI::runGenerations(generations);
+	GOLMPI::gather(world);
+	time->stopComputation();
+
+	int result = 0;
+	if (root)
+	{
+		time->startFinalization();
+		if (!GOLFile::save(OutputFile, world, outputFormat))
+		{
+			std::cerr << "COULD NOT WRITE OUTPUT-FILE." << std::endl;
+			result = 1;
+		}
+		time->stopFinalization();
+
+		if (prettyPrint)
+			time->print(true);
+		if (showMeasurements)
+			std::cout << time->getResults() << std::endl;
+		if (!timingFile.empty())
+		{
+			std::ofstream timing(timingFile, std::ios::out | std::ios::trunc);
+			time->writeJSON(timing);
+		}
+	}
+	delete world;
+	GOLMPI::finalize();
+	return result;
+#else
+	(void)argc;
+	(void)argv;
+	std::cerr << "MPI mode needs a build with GOL_MPI defined and an MPI library (e.g. mpicxx -DGOL_MPI)." << std::endl;
+	return 1;
+#endif
 }
 
+std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	std::istringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+			items.push_back(item);
+	}
+	return items;
+}
 
 void processArgs(int argc, char* argv[])
 {
@@ -194,6 +940,16 @@ void processArgs(int argc, char* argv[])
 			OutputFile = argData;
 			i++;
 			break;
+		case ArgumentType::LOAD_FORMAT:
+			if (!GOLFile::parseFormat(argData, inputFormat))
+				showWrongArgs();
+			i++;
+			break;
+		case ArgumentType::SAVE_FORMAT:
+			if (!GOLFile::parseFormat(argData, outputFormat))
+				showWrongArgs();
+			i++;
+			break;
 		case ArgumentType::GENERATIONS:
 			if (argData.empty())
 				showWrongArgs();
@@ -218,6 +974,200 @@ void processArgs(int argc, char* argv[])
 			numberOfThreads = std::stoi(argData);
 			i++;
 			break;
+		case ArgumentType::TILE_SIZE:
+			if (argData.empty() || std::stoi(argData) <= 0)
+				showWrongArgs();
+			tileSize = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::TILE_DEPTH:
+			if (argData.empty() || std::stoi(argData) <= 0)
+				showWrongArgs();
+			tileDepth = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::WORK_GROUP:
+		{
+			// Format: <width>x<height>
+			size_t separator = argData.find('x');
+			if (separator == std::string::npos || std::stoi(argData.substr(0, separator)) <= 0 || std::stoi(argData.substr(separator + 1)) <= 0)
+				showWrongArgs();
+			workGroupWidth = std::stoi(argData.substr(0, separator));
+			workGroupHeight = std::stoi(argData.substr(separator + 1));
+			i++;
+			break;
+		}
+		case ArgumentType::OCL_DEPTH:
+			if (argData.empty() || std::stoi(argData) <= 0)
+				showWrongArgs();
+			oclDepth = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::CL_PLATFORM:
+			if (argData.empty() || std::stoi(argData) < 0)
+				showWrongArgs();
+			clPlatform = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::CL_DEVICE:
+			if (argData.empty() || std::stoi(argData) < 0)
+				showWrongArgs();
+			clDevice = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::NODE_LIMIT:
+			if (argData.empty() || std::stoll(argData) <= 0)
+				showWrongArgs();
+			nodeLimit = std::stoll(argData);
+			i++;
+			break;
+		case ArgumentType::ACTIVE_TILES:
+			if (argData.empty() || std::stoi(argData) <= 0)
+				showWrongArgs();
+			activeTileSize = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::WINDOW:
+		{
+			// Format: <x>,<y>,<width>,<height>
+			long long x, y, windowWidth, windowHeight;
+			char separator1, separator2, separator3;
+			std::istringstream stream(argData);
+			if (!(stream >> x >> separator1 >> y >> separator2 >> windowWidth >> separator3 >> windowHeight) || windowWidth <= 0 || windowHeight <= 0)
+				showWrongArgs();
+			GOLSparse::setWindow(x, y, (unsigned int)windowWidth, (unsigned int)windowHeight);
+			i++;
+			break;
+		}
+		case ArgumentType::SNAPSHOT_EVERY:
+			if (argData.empty() || std::stoi(argData) <= 0)
+				showWrongArgs();
+			snapshotEvery = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::SNAPSHOT:
+			if (argData.empty())
+				showWrongArgs();
+			snapshotPattern = argData;
+			i++;
+			break;
+		case ArgumentType::BENCHMARK:
+			if (argData.empty())
+				showWrongArgs();
+			benchReport = argData;
+			i++;
+			break;
+		case ArgumentType::BENCH_BOARDS:
+			benchBoards = splitList(argData);
+			if (benchBoards.empty())
+				showWrongArgs();
+			i++;
+			break;
+		case ArgumentType::BENCH_MODES:
+			benchModes = splitList(argData);
+			if (benchModes.empty())
+				showWrongArgs();
+			for (const std::string& name : benchModes)
+			{
+				// mpi mode needs several processes, auto is only resolved for a single run.
+				if (modeMap.find(name) == modeMap.end() || name == "mpi" || name == "auto")
+					showWrongArgs();
+			}
+			i++;
+			break;
+		case ArgumentType::BENCH_THREADS:
+			benchThreads.clear();
+			for (const std::string& count : splitList(argData))
+			{
+				if (std::stoi(count) <= 0)
+					showWrongArgs();
+				benchThreads.push_back(std::stoi(count));
+			}
+			if (benchThreads.empty())
+				showWrongArgs();
+			i++;
+			break;
+		case ArgumentType::BENCH_TRIALS:
+			if (argData.empty() || std::stoi(argData) <= 0)
+				showWrongArgs();
+			benchTrials = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::BENCH_WARMUP:
+			if (argData.empty() || std::stoi(argData) < 0)
+				showWrongArgs();
+			benchWarmup = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::BENCH_SEED:
+			if (argData.empty())
+				showWrongArgs();
+			benchSeed = std::stoul(argData);
+			i++;
+			break;
+		case ArgumentType::PERF:
+			hardwareCounters = true;
+			break;
+		case ArgumentType::TIMING_JSON:
+			if (argData.empty())
+				showWrongArgs();
+			timingFile = argData;
+			i++;
+			break;
+		case ArgumentType::DETECT_CYCLES:
+			CycleDetector::setEnabled(true);
+			break;
+		case ArgumentType::RULE:
+		{
+			Rule rule;
+			if (!Rule::parse(argData, rule))
+				showWrongArgs();
+			Rule::setActive(rule);
+			ruleSet = true;
+			i++;
+			break;
+		}
+		case ArgumentType::MPI_GRID:
+		{
+			// Format: <columns>x<rows>
+			size_t separator = argData.find('x');
+			if (separator == std::string::npos || std::stoi(argData.substr(0, separator)) <= 0 || std::stoi(argData.substr(separator + 1)) <= 0)
+				showWrongArgs();
+			mpiColumns = std::stoi(argData.substr(0, separator));
+			mpiRows = std::stoi(argData.substr(separator + 1));
+			i++;
+			break;
+		}
+		case ArgumentType::HALO_DEPTH:
+			if (argData.empty() || std::stoi(argData) <= 0)
+				showWrongArgs();
+			haloDepth = std::stoi(argData);
+			i++;
+			break;
+		case ArgumentType::BATCH:
+			if (argData.empty())
+				showWrongArgs();
+			batchFile = argData;
+			i++;
+			break;
+		case ArgumentType::SERVE:
+			if (argData.empty())
+				showWrongArgs();
+			serveSocket = argData;
+			i++;
+			break;
+		case ArgumentType::AUTOTUNE:
+			if (argData.empty())
+				showWrongArgs();
+			autotuneBoard = argData;
+			i++;
+			break;
+		case ArgumentType::PROFILE:
+			if (argData.empty())
+				showWrongArgs();
+			profileFile = argData;
+			i++;
+			break;
 		case ArgumentType::HELP:
 			showHelp();
 			std::exit(0);
@@ -241,10 +1191,40 @@ void showHelp()
 	std::cout << std::endl;
 	std::cout << "--load <file>                            -> Filename to read from." << std::endl;
 	std::cout << "--save <file>                            -> Filename to save to." << std::endl;
+	std::cout << "--load-format <format>                   -> Format of the loaded file: gol | golb | golz | rle (default: from header or extension)." << std::endl;
+	std::cout << "--save-format <format>                   -> Format of the saved file: gol | golb | golz | rle (default: from extension)." << std::endl;
 	std::cout << "--generations <number of generations>    -> Number of generations to go through." << std::endl;
 	std::cout << "--measure                                -> Whether to print out time measurements." << std::endl;
 	std::cout << "--pretty                                 -> Whether to print out time pretty." << std::endl;
-	std::cout << "--mode <modeType>                        -> Choose between: seq | omp | ocl" << std::endl;
+	std::cout << "--mode <modeType>                        -> Choose between: seq | omp | ocl | bit | simd | tiled | bands | ocltiled | hashlife | sparse | mpi | steal | lut | auto" << std::endl;
 	std::cout << "--threads <numberOfThreads>              -> Sets the threads used by OpenMP. If not set, uses all available." << std::endl;
+	std::cout << "--tile-size <cells>                      -> Tile width and height used by tiled and steal mode (default 256)." << std::endl;
+	std::cout << "--tile-depth <generations>               -> Generations per tile pass used by tiled mode (default 8)." << std::endl;
+	std::cout << "--work-group <width>x<height>            -> Work-group shape used by ocltiled mode (default 16x16)." << std::endl;
+	std::cout << "--ocl-depth <generations>                -> Generations per kernel launch used by ocltiled mode (default 4)." << std::endl;
+	std::cout << "--cl-platform <index>                    -> OpenCL platform of ocl and ocltiled mode (default 0)." << std::endl;
+	std::cout << "--cl-device <index>                      -> Device of that platform (default 0). Out of range lists all platforms and devices." << std::endl;
+	std::cout << "--node-limit <nodes>                     -> Nodes kept by hashlife mode before collecting garbage (default 4000000)." << std::endl;
+	std::cout << "--active-tiles <cells>                   -> seq and omp only compute tiles of this size that (or whose neighbors) changed." << std::endl;
+	std::cout << "--window <x>,<y>,<width>,<height>        -> Area saved by sparse mode. If not set, saves the bounding box of all alive cells." << std::endl;
+	std::cout << "--snapshot-every <generations>           -> Save the board every n generations in the background (not hashlife or sparse)." << std::endl;
+	std::cout << "--snapshot <pattern>                     -> Snapshot file, {generation} is replaced (default snapshot_{generation}.gol)." << std::endl;
+	std::cout << "--benchmark <report>                     -> Measure modes on boards instead of a single run, report as CSV (or JSON for .json, - for stdout)." << std::endl;
+	std::cout << "--bench-boards <board,...>               -> Files or <width>x<height> for random boards (default 500x500,1000x1000,2000x2000,4000x4000)." << std::endl;
+	std::cout << "--bench-modes <mode,...>                 -> Modes to measure (default seq,omp,bit,simd,lut,tiled,bands)." << std::endl;
+	std::cout << "--bench-threads <count,...>              -> Thread counts for omp, tiled, bands, sparse and steal (default 1 and all cores)." << std::endl;
+	std::cout << "--bench-trials <runs>                    -> Measured runs per mode and board (default 5)." << std::endl;
+	std::cout << "--bench-warmup <runs>                    -> Unmeasured runs before the trials (default 1)." << std::endl;
+	std::cout << "--bench-seed <seed>                      -> Seed of the random boards (default 1)." << std::endl;
+	std::cout << "--perf                                   -> Count cycles, instructions and LLC misses per phase (Linux perf_event_open)." << std::endl;
+	std::cout << "--timing-json <file>                     -> Write all times, counters, latency histograms and hardware counters as JSON." << std::endl;
+	std::cout << "--detect-cycles                          -> seq, omp, simd and bit stop early once the board repeats (still life or oscillator)." << std::endl;
+	std::cout << "--mpi-grid <columns>x<rows>              -> Blocks of mpi mode, columns * rows must be the number of ranks (default: as square as possible)." << std::endl;
+	std::cout << "--halo-depth <cells>                     -> mpi mode exchanges halos this deep every that many generations (default 1)." << std::endl;
+	std::cout << "--batch <jobfile>                        -> Compute every \"<input> <output>\" line of the file in one process (seq: boards spread over the threads, ocl: equal sizes in one launch)." << std::endl;
+	std::cout << "--serve <socket>                         -> Keep boards in memory and take commands on a Unix domain socket (see README)." << std::endl;
+	std::cout << "--autotune <board>                       -> Measure engines, thread counts and tile settings on a file or <width>x<height>, save the fastest to the profile." << std::endl;
+	std::cout << "--profile <file>                         -> Profile of --autotune and --mode auto (default gol_profile_<host>.txt)." << std::endl;
+	std::cout << "--rule <B/S>                             -> Life-like rule, e.g. B36/S23 (default B3/S23 or the rule of an RLE file). Not simd, bit or sparse." << std::endl;
 	std::cout << "--help                                   -> Prints out this message." << std::endl;
 }
\ No newline at end of file
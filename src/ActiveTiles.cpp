@@ -0,0 +1,34 @@
+#include "ActiveTiles.h"
+
+ActiveTiles::ActiveTiles(unsigned int width, unsigned int height, unsigned int tileSize)
+	: mTilesX((width + tileSize - 1) / tileSize), mTilesY((height + tileSize - 1) / tileSize), mTileSize(tileSize)
+{
+	// Everything counts as changed before the first generation.
+	mChanged.assign(mTilesX * mTilesY, 1);
+	mNext.assign(mTilesX * mTilesY, 0);
+}
+
+bool ActiveTiles::needsUpdate(int tileX, int tileY) const
+{
+	for (int yOffset = -1; yOffset <= 1; yOffset++)
+	{
+		// Wrap around.
+		int y = (tileY + yOffset + mTilesY) % mTilesY;
+		for (int xOffset = -1; xOffset <= 1; xOffset++)
+		{
+			int x = (tileX + xOffset + mTilesX) % mTilesX;
+			if (mChanged[y * mTilesX + x])
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Changes of the generation just computed become the input of the next one.
+ */
+void ActiveTiles::nextGeneration()
+{
+	mChanged.swap(mNext);
+	mNext.assign(mNext.size(), 0);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+
+/**
+ * Splits the board into tiles and remembers which of them changed in the last generation.
+ * A tile only needs to be computed if it or one of its eight neighbors (wrap around) changed.
+ * Skipped tiles are already correct in the other grid: they equal the generation before.
+ */
+class ActiveTiles
+{
+public:
+	ActiveTiles(unsigned int width, unsigned int height, unsigned int tileSize);
+
+	int getTilesX() const { return mTilesX; }
+	int getTilesY() const { return mTilesY; }
+	int getTileCount() const { return mTilesX * mTilesY; }
+	int getTileSize() const { return mTileSize; }
+
+	bool needsUpdate(int tileX, int tileY) const;
+	void setChanged(int tileX, int tileY, bool changed) { mNext[tileY * mTilesX + tileX] = changed; }
+	void nextGeneration();
+
+private:
+	int mTilesX;
+	int mTilesY;
+	int mTileSize;
+	// One char per tile, so threads can write their own tile without races.
+	std::vector<char> mChanged;
+	std::vector<char> mNext;
+};
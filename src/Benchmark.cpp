@@ -0,0 +1,99 @@
+#include "Benchmark.h"
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+Benchmark::Benchmark(unsigned int generations, unsigned int warmup, unsigned int trials)
+	: mGenerations(generations), mWarmup(warmup), mTrials(trials)
+{
+}
+
+double Benchmark::measure(const std::string& mode, unsigned int threads, const std::string& board, const Grid* world,
+	const std::function<void(Grid*, Grid*)>& setup, const std::function<Grid*(Grid*, Grid*, unsigned int)>& run)
+{
+	const unsigned int width = world->getWidth();
+	const unsigned int height = world->getHeight();
+	Grid current(width, height);
+	Grid next(width, height);
+	Result result{ mode, threads, board, width, height, {} };
+
+	for (unsigned int i = 0; i < mWarmup + mTrials; i++)
+	{
+		std::memcpy(current.getData(), world->getData(), world->getSize());
+		next.clear();
+		setup(&current, &next);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		Grid* output = run(&current, &next, mGenerations);
+		std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+
+		// sparse exports a new grid.
+		if (output != &current && output != &next)
+			delete output;
+		if (i >= mWarmup)
+			result.seconds.push_back(duration.count());
+	}
+
+	double median = percentile(result.seconds, 0.5);
+	std::cerr << mode << ", " << threads << " threads, " << board << ": " << median << "s (median)" << std::endl;
+	mResults.push_back(result);
+	return median;
+}
+
+void Benchmark::writeCSV(std::ostream& output) const
+{
+	output << "mode,threads,board,width,height,generations,trials,median_seconds,p95_seconds,median_cell_updates_per_second,p95_cell_updates_per_second" << std::endl;
+	for (const Result& result : mResults)
+	{
+		double updates = (double)result.width * result.height * mGenerations;
+		double median = percentile(result.seconds, 0.5);
+		double p95 = percentile(result.seconds, 0.95);
+		output << result.mode << "," << result.threads << "," << result.board << "," << result.width << "," << result.height << ","
+			<< mGenerations << "," << result.seconds.size() << "," << median << "," << p95 << "," << updates / median << "," << updates / p95 << std::endl;
+	}
+}
+
+void Benchmark::writeJSON(std::ostream& output) const
+{
+	output << "{\n  \"generations\": " << mGenerations << ",\n  \"warmup\": " << mWarmup << ",\n  \"results\": [";
+	for (size_t i = 0; i < mResults.size(); i++)
+	{
+		const Result& result = mResults[i];
+		double updates = (double)result.width * result.height * mGenerations;
+		double median = percentile(result.seconds, 0.5);
+		double p95 = percentile(result.seconds, 0.95);
+
+		// Board names are file paths, escape backslashes and quotes.
+		std::string board;
+		for (char c : result.board)
+		{
+			if (c == '\\' || c == '"')
+				board += '\\';
+			board += c;
+		}
+
+		output << (i == 0 ? "\n" : ",\n") << "    {\"mode\": \"" << result.mode << "\", \"threads\": " << result.threads
+			<< ", \"board\": \"" << board << "\", \"width\": " << result.width << ", \"height\": " << result.height
+			<< ", \"median_seconds\": " << median << ", \"p95_seconds\": " << p95
+			<< ", \"median_cell_updates_per_second\": " << updates / median << ", \"p95_cell_updates_per_second\": " << updates / p95
+			<< ", \"seconds\": [";
+		for (size_t j = 0; j < result.seconds.size(); j++)
+			output << (j == 0 ? "" : ", ") << result.seconds[j];
+		output << "]}";
+	}
+	output << "\n  ]\n}" << std::endl;
+}
+
+/**
+ * Nearest rank: the smallest value that at least fraction of all values are less than or equal to.
+ */
+double Benchmark::percentile(std::vector<double> values, double fraction)
+{
+	if (values.empty())
+		return 0;
+	std::sort(values.begin(), values.end());
+	size_t rank = (size_t)std::ceil(fraction * values.size());
+	return values[std::max<size_t>(rank, 1) - 1];
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+#include "Grid.h"
+
+/**
+ * Repeated measurements of engines on boards, reported as cell updates per second.
+ * Every run starts from the same board; setup is not measured, warmup runs are not reported.
+ */
+class Benchmark
+{
+public:
+	Benchmark(unsigned int generations, unsigned int warmup, unsigned int trials);
+
+	// Returns the median run time in seconds.
+	double measure(const std::string& mode, unsigned int threads, const std::string& board, const Grid* world,
+		const std::function<void(Grid*, Grid*)>& setup, const std::function<Grid*(Grid*, Grid*, unsigned int)>& run);
+
+	// One line per measurement. p95 is the 95th percentile of the run time (the slow end).
+	void writeCSV(std::ostream& output) const;
+	void writeJSON(std::ostream& output) const;
+
+private:
+	struct Result
+	{
+		std::string mode;
+		unsigned int threads;
+		std::string board;
+		unsigned int width;
+		unsigned int height;
+		std::vector<double> seconds;
+	};
+	static double percentile(std::vector<double> values, double fraction);
+
+	unsigned int mGenerations;
+	unsigned int mWarmup;
+	unsigned int mTrials;
+	std::vector<Result> mResults;
+};
@@ -0,0 +1,83 @@
+#include "CycleDetector.h"
+#include "../util/Timing.h"
+#include <iostream>
+#include <cstring>
+
+static bool enabled = false;
+
+void CycleDetector::setEnabled(bool value)
+{
+	enabled = value;
+}
+
+bool CycleDetector::isEnabled()
+{
+	return enabled;
+}
+
+unsigned int CycleDetector::check(unsigned int generation, uint64_t hash, const Grid* world, unsigned int generations)
+{
+	return check(generation, hash, nullptr, 0, world, generations);
+}
+
+unsigned int CycleDetector::check(unsigned int generation, uint64_t hash, const uint64_t* words, size_t count, unsigned int generations)
+{
+	return check(generation, hash, words, count * sizeof(uint64_t), nullptr, generations);
+}
+
+unsigned int CycleDetector::check(unsigned int generation, uint64_t hash, const void* board, size_t bytes, const Grid* world, unsigned int generations)
+{
+	if (mPeriod > 0 && generation == mCandidate + mPeriod)
+	{
+		copy(mCompare, board, bytes, world);
+		if (mCompare == mBoard)
+		{
+			// The board of mCandidate repeats every period generations, skip whole periods.
+			unsigned int remaining = generations - generation;
+			unsigned int skipped = remaining - remaining % mPeriod;
+			Timing* time = Timing::getInstance();
+			time->setCounter("cycle start generation", mCandidate);
+			time->setCounter("cycle period", mPeriod);
+			time->setCounter("cycle generations skipped", skipped);
+			std::cerr << "Cycle of period " << mPeriod << " from generation " << mCandidate << " on, skipping " << skipped << " generations." << std::endl;
+			mPeriod = 0;
+			return generations - skipped;
+		}
+		// Hash collision.
+		mPeriod = 0;
+	}
+
+	if (mPeriod == 0)
+	{
+		// Shortest period whose hash matches.
+		unsigned int known = mCount < HISTORY ? mCount : HISTORY;
+		for (unsigned int period = 1; period <= known; period++)
+		{
+			if (mHashes[(mCount - period) % HISTORY] == hash)
+			{
+				mPeriod = period;
+				mCandidate = generation;
+				copy(mBoard, board, bytes, world);
+				break;
+			}
+		}
+	}
+
+	mHashes[mCount % HISTORY] = hash;
+	mCount++;
+	return generations;
+}
+
+// Cells only (the halo of a grid may be outdated).
+void CycleDetector::copy(std::vector<unsigned char>& target, const void* board, size_t bytes, const Grid* world) const
+{
+	if (world == nullptr)
+	{
+		target.assign(static_cast<const unsigned char*>(board), static_cast<const unsigned char*>(board) + bytes);
+		return;
+	}
+	const size_t width = world->getWidth();
+	target.resize(width * world->getHeight());
+	for (unsigned int y = 0; y < world->getHeight(); y++)
+		std::memcpy(target.data() + y * width, world->getRow(y), width);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "Grid.h"
+
+/**
+ * Finds still lifes and oscillators while an engine runs. Engines hash each row right after computing it
+ * (hashRow, combined with ^) and pass the board hash of every generation to check().
+ * A hash equal to one of the last HISTORY generations is confirmed by comparing the board with a copy
+ * one period later; after that only generations % period are left to compute.
+ */
+class CycleDetector
+{
+public:
+	// Longest period found.
+	static constexpr int HISTORY = 8;
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	static inline uint64_t hashRow(const void* row, size_t bytes, int y)
+	{
+		const unsigned char* data = static_cast<const unsigned char*>(row);
+		uint64_t hash = 0x9E3779B97F4A7C15ULL * (uint64_t)(y + 1);
+		size_t i = 0;
+		for (; i + 8 <= bytes; i += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, data + i, sizeof(word));
+			hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+			hash ^= hash >> 32;
+		}
+		for (; i < bytes; i++)
+			hash = (hash ^ data[i]) * 0xC4CEB9FE1A85EC53ULL;
+		return hash ^ (hash >> 29);
+	}
+
+	// generation: number of generations computed so far, generations: total requested.
+	// Returns the (possibly reduced) total to compute.
+	unsigned int check(unsigned int generation, uint64_t hash, const Grid* world, unsigned int generations);
+	unsigned int check(unsigned int generation, uint64_t hash, const uint64_t* words, size_t count, unsigned int generations);
+
+private:
+	unsigned int check(unsigned int generation, uint64_t hash, const void* board, size_t bytes, const Grid* world, unsigned int generations);
+	void copy(std::vector<unsigned char>& target, const void* board, size_t bytes, const Grid* world) const;
+
+	uint64_t mHashes[HISTORY] = {};
+	unsigned int mCount = 0;
+
+	// Candidate: board at mCandidate, confirmed if equal at mCandidate + mPeriod.
+	int mPeriod = 0;
+	unsigned int mCandidate = 0;
+	std::vector<unsigned char> mBoard;
+	std::vector<unsigned char> mCompare;
+};
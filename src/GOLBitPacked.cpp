@@ -0,0 +1,119 @@
+#include "GOLBitPacked.h"
+#include "../util/Timing.h"
+#include "CycleDetector.h"
+
+// 64 cells per word. Bit b of word i in a row is the cell at x = i * 64 + b.
+static unsigned int wordsPerRow;
+static uint64_t lastWordMask;
+static unsigned int lastBit;
+
+static uint64_t* packedWorld = nullptr;
+static uint64_t* packedNewWorld = nullptr;
+
+void GOLBitPacked::setup(const Grid* world)
+{
+	allocate(world->getWidth(), world->getHeight());
+	packWorld(world, packedWorld);
+}
+
+// Read the file straight into the packed layout.
+bool GOLBitPacked::setup(GOLFile& file)
+{
+	allocate(file.getWidth(), file.getHeight());
+	return file.readPacked(packedWorld, wordsPerRow);
+}
+
+void GOLBitPacked::allocate(unsigned int width, unsigned int height)
+{
+	wordsPerRow = (width + 63) / 64;
+	lastBit = (width - 1) % 64;
+	lastWordMask = lastBit == 63 ? ~0ULL : (1ULL << (lastBit + 1)) - 1;
+
+	delete[] packedWorld;
+	delete[] packedNewWorld;
+	packedWorld = new uint64_t[wordsPerRow * height];
+	packedNewWorld = new uint64_t[wordsPerRow * height];
+}
+
+Grid* GOLBitPacked::runGenerations(Grid* world, Grid* newWorld, unsigned int generations)
+{
+	const unsigned int height = world->getHeight();
+	const unsigned int last = wordsPerRow - 1;
+	const bool detectCycles = CycleDetector::isEnabled();
+	CycleDetector cycles;
+	uint64_t* temp;
+	for (unsigned int i = 0; i < generations; i++)
+	{
+		Timing::Scope generation("generation", true);
+		uint64_t hash = 0;
+		for (unsigned int y = 0; y < height; y++)
+		{
+			// Wrap around (rows).
+			const uint64_t* above = packedWorld + (y == 0 ? height - 1 : y - 1) * wordsPerRow;
+			const uint64_t* row = packedWorld + y * wordsPerRow;
+			const uint64_t* below = packedWorld + (y == height - 1 ? 0 : y + 1) * wordsPerRow;
+			uint64_t* newRow = packedNewWorld + y * wordsPerRow;
+
+			for (unsigned int w = 0; w < wordsPerRow; w++)
+			{
+				// Wrap around (columns): the bit shifted in at x = 0 is the cell at x = width - 1 and vice versa.
+				unsigned int prev = w == 0 ? last : w - 1;
+				unsigned int next = w == last ? 0 : w + 1;
+				unsigned int prevShift = w == 0 ? lastBit : 63;
+				unsigned int nextShift = w == last ? lastBit : 63;
+
+				uint64_t a = above[w];
+				uint64_t aL = (a << 1) | ((above[prev] >> prevShift) & 1);
+				uint64_t aR = (a >> 1) | ((above[next] & 1) << nextShift);
+				uint64_t c = row[w];
+				uint64_t cL = (c << 1) | ((row[prev] >> prevShift) & 1);
+				uint64_t cR = (c >> 1) | ((row[next] & 1) << nextShift);
+				uint64_t b = below[w];
+				uint64_t bL = (b << 1) | ((below[prev] >> prevShift) & 1);
+				uint64_t bR = (b >> 1) | ((below[next] & 1) << nextShift);
+
+				newRow[w] = nextWord(aL, a, aR, cL, c, cR, bL, b, bR);
+			}
+			// Clear bits past the last column.
+			newRow[last] &= lastWordMask;
+			if (detectCycles)
+				hash ^= CycleDetector::hashRow(newRow, wordsPerRow * sizeof(uint64_t), y);
+		}
+		temp = packedWorld;
+		packedWorld = packedNewWorld;
+		packedNewWorld = temp;
+		if (detectCycles)
+			generations = cycles.check(i + 1, hash, packedWorld, (size_t)wordsPerRow * height, generations);
+	}
+
+	unpackWorld(packedWorld, newWorld);
+	return newWorld;
+}
+
+void GOLBitPacked::packWorld(const Grid* world, uint64_t* packed)
+{
+	const unsigned int width = world->getWidth();
+	const unsigned int height = world->getHeight();
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const bool* cells = world->getRow(y);
+		uint64_t* row = packed + y * wordsPerRow;
+		for (unsigned int w = 0; w < wordsPerRow; w++)
+			row[w] = 0;
+		for (unsigned int x = 0; x < width; x++)
+			row[x / 64] |= (uint64_t)cells[x] << (x % 64);
+	}
+}
+
+void GOLBitPacked::unpackWorld(const uint64_t* packed, Grid* world)
+{
+	const unsigned int width = world->getWidth();
+	const unsigned int height = world->getHeight();
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const uint64_t* row = packed + y * wordsPerRow;
+		bool* cells = world->getRow(y);
+		for (unsigned int x = 0; x < width; x++)
+			cells[x] = (row[x / 64] >> (x % 64)) & 1;
+	}
+}
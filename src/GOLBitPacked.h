@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include "Grid.h"
+#include "GOLFile.h"
+
+class GOLBitPacked
+{
+public:
+	static void setup(const Grid* world);
+	static bool setup(GOLFile& file);
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations);
+
+	/**
+	 * Next generation of 64 cells at once. Arguments are the rows above (a), of (c) and below (b) the cells,
+	 * each also shifted so bit x holds the left (L) and right (R) neighbor of cell x.
+	 */
+	static inline uint64_t nextWord(uint64_t aL, uint64_t a, uint64_t aR, uint64_t cL, uint64_t c, uint64_t cR, uint64_t bL, uint64_t b, uint64_t bR)
+	{
+		// Count neighbors with full adders. Every bit lane is one cell.
+		// Top row: sum (weight 1) and carry (weight 2).
+		uint64_t topSum = aL ^ a ^ aR;
+		uint64_t topCarry = (aL & a) | (aR & (aL ^ a));
+		// Middle row (without self).
+		uint64_t midSum = cL ^ cR;
+		uint64_t midCarry = cL & cR;
+		// Bottom row.
+		uint64_t botSum = bL ^ b ^ bR;
+		uint64_t botCarry = (bL & b) | (bR & (bL ^ b));
+
+		// Bit 0 of the neighbor count.
+		uint64_t bit0 = topSum ^ midSum ^ botSum;
+		uint64_t carry0 = (topSum & midSum) | (botSum & (topSum ^ midSum));
+		// Bit 1 and 2 of the neighbor count (8 neighbors wrap to 0, which is dead anyway).
+		uint64_t twosSum = topCarry ^ midCarry ^ botCarry;
+		uint64_t twosCarry = (topCarry & midCarry) | (botCarry & (topCarry ^ midCarry));
+		uint64_t bit1 = twosSum ^ carry0;
+		uint64_t bit2 = twosCarry ^ (twosSum & carry0);
+
+		// Apply gol-rules: alive with 3 neighbors, or alive with 2 neighbors if alive before.
+		return bit1 & ~bit2 & (bit0 | c);
+	}
+
+private:
+	static void allocate(unsigned int width, unsigned int height);
+	static void packWorld(const Grid* world, uint64_t* packed);
+	static void unpackWorld(const uint64_t* packed, Grid* world);
+};
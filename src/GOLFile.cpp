@@ -0,0 +1,822 @@
+#include "GOLFile.h"
+#include <emmintrin.h>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Header of the binary formats.
+struct BinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t compressed;
+	uint32_t blockRows;
+	uint64_t reserved;
+};
+static_assert(sizeof(BinaryHeader) == 32, "binary header must be 32 bytes");
+static const char MAGIC[4] = {'G', 'O', 'L', 'B'};
+static const uint32_t VERSION = 1;
+
+// Bits of the last word of a row that are inside the board.
+static uint64_t lastWordMask(unsigned int width)
+{
+	unsigned int lastBit = (width - 1) % 64;
+	return lastBit == 63 ? ~0ULL : (1ULL << (lastBit + 1)) - 1;
+}
+
+static void writeVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static bool readVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (unsigned int shift = 0; in < end && shift < 64; shift += 7)
+	{
+		uint8_t byte = *in++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// Alternating runs of zero words and literal words (sparse boards are mostly zero words).
+static void compressWords(const uint64_t* words, size_t count, std::vector<uint8_t>& out)
+{
+	size_t i = 0;
+	while (i < count)
+	{
+		size_t zeros = 0;
+		while (i + zeros < count && words[i + zeros] == 0)
+			zeros++;
+		size_t literals = 0;
+		while (i + zeros + literals < count && words[i + zeros + literals] != 0)
+			literals++;
+		writeVarint(out, zeros);
+		writeVarint(out, literals);
+		const uint8_t* bytes = (const uint8_t*)(words + i + zeros);
+		out.insert(out.end(), bytes, bytes + literals * sizeof(uint64_t));
+		i += zeros + literals;
+	}
+}
+
+bool GOLFile::parseFormat(const std::string& name, Format& format)
+{
+	static const std::pair<const char*, Format> names[] = {
+		{"auto", Format::AUTO}, {"gol", Format::TEXT}, {"golb", Format::PACKED}, {"golz", Format::COMPRESSED}, {"rle", Format::RLE}
+	};
+	for (const auto& entry : names)
+	{
+		if (name == entry.first)
+		{
+			format = entry.second;
+			return true;
+		}
+	}
+	return false;
+}
+
+GOLFile::Format GOLFile::formatFromExtension(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	Format format;
+	if (extension != "auto" && parseFormat(extension, format))
+		return format;
+	return Format::TEXT;
+}
+
+GOLFile::~GOLFile()
+{
+	close();
+}
+
+/**
+ * Map the file and read the header. Rows are checked while reading.
+ */
+bool GOLFile::open(const std::string& path, Format format)
+{
+	close();
+	mHasRule = false;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		mError = "COULD NOT OPEN INPUT-FILE. WRONG PATH?";
+		return false;
+	}
+	mFile = file;
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	mSize = (size_t)size.QuadPart;
+	if (mSize > 0)
+	{
+		mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		mData = mMapping ? (const char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	}
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		mError = "COULD NOT OPEN INPUT-FILE. WRONG PATH?";
+		return false;
+	}
+	struct stat status;
+	fstat(file, &status);
+	mSize = (size_t)status.st_size;
+	if (mSize > 0)
+	{
+		void* mapped = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+		mData = mapped == MAP_FAILED ? nullptr : (const char*)mapped;
+		if (mData)
+			madvise(mapped, mSize, MADV_SEQUENTIAL);
+	}
+	::close(file);
+#endif
+	if (mData == nullptr)
+	{
+		mError = "COULD NOT MAP INPUT-FILE (EMPTY?).";
+		return false;
+	}
+
+	if (format == Format::AUTO)
+	{
+		// Binary files are recognized by their header, everything else by the extension.
+		if (mSize >= sizeof(MAGIC) && std::memcmp(mData, MAGIC, sizeof(MAGIC)) == 0)
+			format = Format::PACKED;
+		else
+			format = formatFromExtension(path);
+	}
+
+	mFormat = format;
+	switch (format)
+	{
+	case Format::PACKED:
+	case Format::COMPRESSED:
+		return openBinary();
+	case Format::RLE:
+		return openRLE();
+	default:
+		return openText();
+	}
+}
+
+bool GOLFile::openText()
+{
+	// Header: <width>,<height> and line ending.
+	size_t i = 0;
+	unsigned long long width = 0, height = 0;
+	while (i < mSize && mData[i] >= '0' && mData[i] <= '9')
+		width = width * 10 + (mData[i++] - '0');
+	bool comma = i < mSize && mData[i] == ',';
+	i++;
+	size_t heightStart = i;
+	while (i < mSize && mData[i] >= '0' && mData[i] <= '9')
+		height = height * 10 + (mData[i++] - '0');
+	size_t lineEnding = 0;
+	if (i < mSize && mData[i] == '\r')
+		lineEnding++;
+	if (i + lineEnding < mSize && mData[i + lineEnding] == '\n')
+		lineEnding++;
+	if (!comma || i == heightStart || width == 0 || height == 0 || width > 0x7FFFFFFF || height > 0x7FFFFFFF || lineEnding == 0 || mData[i + lineEnding - 1] != '\n')
+	{
+		mError = "Malformed header, expected <width>,<height> in the first line.";
+		return false;
+	}
+
+	mWidth = (unsigned int)width;
+	mHeight = (unsigned int)height;
+	mFirstRow = i + lineEnding;
+	// All rows use the line ending of the header.
+	mRowStride = mWidth + lineEnding;
+	return true;
+}
+
+void GOLFile::close()
+{
+#ifdef _WIN32
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile)
+		CloseHandle(mFile);
+	mMapping = nullptr;
+	mFile = nullptr;
+#else
+	if (mData)
+		munmap((void*)mData, mSize);
+#endif
+	mData = nullptr;
+	mSize = 0;
+	mBlockOffsets.clear();
+	mBlockSizes.clear();
+	mDecoded.clear();
+}
+
+/**
+ * Header, then either the rows or the block table. The header decides whether the file is compressed.
+ */
+bool GOLFile::openBinary()
+{
+	BinaryHeader header;
+	if (mSize < sizeof(header))
+	{
+		mError = "Malformed binary board: file is smaller than the header.";
+		return false;
+	}
+	std::memcpy(&header, mData, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION)
+	{
+		mError = "Malformed binary board: unknown header or version.";
+		return false;
+	}
+	if (header.width == 0 || header.height == 0 || header.width > 0x7FFFFFFF || header.height > 0x7FFFFFFF)
+	{
+		mError = "Malformed binary board: invalid size.";
+		return false;
+	}
+
+	mWidth = header.width;
+	mHeight = header.height;
+	mRowStride = (mWidth + 63) / 64 * sizeof(uint64_t);
+	mFirstRow = sizeof(header);
+	if (!header.compressed)
+	{
+		mFormat = Format::PACKED;
+		if ((mSize - mFirstRow) / mRowStride < mHeight)
+		{
+			mError = "Malformed binary board: file ends before row " + std::to_string((mSize - mFirstRow) / mRowStride) + ".";
+			return false;
+		}
+		return true;
+	}
+
+	mFormat = Format::COMPRESSED;
+	if (header.blockRows == 0)
+	{
+		mError = "Malformed binary board: invalid block size.";
+		return false;
+	}
+	mBlockRows = header.blockRows;
+	size_t blocks = (mHeight + mBlockRows - 1) / mBlockRows;
+	if ((mSize - mFirstRow) / sizeof(uint64_t) < blocks)
+	{
+		mError = "Malformed binary board: file ends inside the block table.";
+		return false;
+	}
+	mBlockOffsets.resize(blocks);
+	mBlockSizes.resize(blocks);
+	size_t offset = mFirstRow + blocks * sizeof(uint64_t);
+	for (size_t block = 0; block < blocks; block++)
+	{
+		uint64_t size;
+		std::memcpy(&size, mData + mFirstRow + block * sizeof(uint64_t), sizeof(size));
+		if (size > mSize - offset)
+		{
+			mError = "Malformed binary board: file ends inside block " + std::to_string(block) + ".";
+			return false;
+		}
+		mBlockOffsets[block] = offset;
+		mBlockSizes[block] = (size_t)size;
+		offset += (size_t)size;
+	}
+	return true;
+}
+
+/**
+ * RLE is sequential, so it is decoded completely while opening.
+ * Header "x = <width>, y = <height>[, rule = B3/S23]" (any life-like rule), then runs of 'b' (dead) and 'o' (alive),
+ * '$' ends a row and '!' the pattern. Lines starting with '#' are comments.
+ */
+bool GOLFile::openRLE()
+{
+	size_t i = 0;
+	unsigned int line = 1;
+	auto fail = [&](const std::string& message)
+	{
+		mError = "Malformed RLE in line " + std::to_string(line) + ": " + message + ".";
+		return false;
+	};
+
+	// Comments.
+	while (i < mSize && (mData[i] == '#' || mData[i] == '\n' || mData[i] == '\r'))
+	{
+		while (i < mSize && mData[i] != '\n')
+			i++;
+		i++;
+		line++;
+	}
+	if (i >= mSize)
+		return fail("missing header");
+
+	// Header without whitespace.
+	std::string header;
+	for (; i < mSize && mData[i] != '\n'; i++)
+	{
+		if (!std::isspace((unsigned char)mData[i]))
+			header += mData[i];
+	}
+	unsigned long long width = 0, height = 0;
+	size_t p = 0;
+	auto number = [&](unsigned long long& value)
+	{
+		size_t start = p;
+		while (p < header.size() && std::isdigit((unsigned char)header[p]) && value <= 0x7FFFFFFF)
+			value = value * 10 + (header[p++] - '0');
+		return p > start && value > 0 && value <= 0x7FFFFFFF;
+	};
+	if (header.compare(0, 2, "x=") != 0 || (p = 2, !number(width)) || header.compare(p, 3, ",y=") != 0 || (p += 3, !number(height)))
+		return fail("expected header \"x = <width>, y = <height>\"");
+	if (p < header.size())
+	{
+		std::string rule = header.substr(p);
+		std::transform(rule.begin(), rule.end(), rule.begin(), [](unsigned char c) { return (char)std::toupper(c); });
+		if (rule.compare(0, 6, ",RULE=") != 0 || !Rule::parse(rule.substr(6), mRule))
+			return fail("expected \"rule = B<counts>/S<counts>\" after the size");
+		mHasRule = true;
+	}
+
+	mWidth = (unsigned int)width;
+	mHeight = (unsigned int)height;
+	const size_t wordsPerRow = (mWidth + 63) / 64;
+	mDecoded.assign(wordsPerRow * mHeight, 0);
+
+	// Runs.
+	unsigned long long x = 0, y = 0, count = 0;
+	for (; i < mSize && mData[i] != '!'; i++)
+	{
+		char c = mData[i];
+		if (c >= '0' && c <= '9')
+		{
+			count = count * 10 + (c - '0');
+			if (count > 0xFFFFFFFF)
+				return fail("run too long");
+			continue;
+		}
+
+		unsigned long long run = count == 0 ? 1 : count;
+		count = 0;
+		if (c == 'b' || c == '.')
+			x += run;
+		else if (c == 'o')
+		{
+			if (y >= mHeight || x + run > mWidth)
+				return fail("alive cells outside of the " + std::to_string(mWidth) + "x" + std::to_string(mHeight) + " board");
+			uint64_t* row = mDecoded.data() + y * wordsPerRow;
+			for (unsigned long long end = x + run; x < end; x++)
+				row[x / 64] |= 1ULL << (x % 64);
+		}
+		else if (c == '$')
+		{
+			y += run;
+			x = 0;
+		}
+		else if (c == '\n')
+			line++;
+		else if (!std::isspace((unsigned char)c))
+			return fail(std::string("unexpected character '") + c + "'");
+	}
+	return true;
+}
+
+bool GOLFile::readTextInto(Grid* world)
+{
+	const int height = mHeight;
+	mErrorRow = -1;
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height; y++)
+	{
+		const char* row = mData + mFirstRow + y * mRowStride;
+		if (!validateRow(y, row))
+			continue;
+
+		// Compare 16 characters at once, 'x' becomes 1 and everything else 0.
+		bool* cells = world->getRow(y);
+		const __m128i alive = _mm_set1_epi8(ALIVE);
+		const __m128i one = _mm_set1_epi8(1);
+		unsigned int x = 0;
+		for (; x + 16 <= mWidth; x += 16)
+		{
+			__m128i characters = _mm_loadu_si128((const __m128i*)(row + x));
+			_mm_storeu_si128((__m128i*)(cells + x), _mm_and_si128(_mm_cmpeq_epi8(characters, alive), one));
+		}
+		for (; x < mWidth; x++)
+			cells[x] = row[x] == ALIVE;
+	}
+	return mErrorRow < 0;
+}
+
+bool GOLFile::readTextPacked(uint64_t* packed, size_t wordsPerRow)
+{
+	const int height = mHeight;
+	mErrorRow = -1;
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height; y++)
+	{
+		const char* row = mData + mFirstRow + y * mRowStride;
+		uint64_t* words = packed + y * wordsPerRow;
+		std::memset(words, 0, wordsPerRow * sizeof(uint64_t));
+		if (!validateRow(y, row))
+			continue;
+
+		// Compare 16 characters at once, the byte mask gives 16 bits of the row.
+		const __m128i alive = _mm_set1_epi8(ALIVE);
+		unsigned int x = 0;
+		for (; x + 16 <= mWidth; x += 16)
+		{
+			uint64_t bits = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(row + x)), alive));
+			words[x / 64] |= bits << (x % 64);
+		}
+		for (; x < mWidth; x++)
+			words[x / 64] |= (uint64_t)(row[x] == ALIVE) << (x % 64);
+	}
+	return mErrorRow < 0;
+}
+
+bool GOLFile::readInto(Grid* world)
+{
+	if (mFormat == Format::TEXT)
+		return readTextInto(world);
+
+	// Binary and RLE: packed rows first, then one bool per bit.
+	const size_t wordsPerRow = (mWidth + 63) / 64;
+	std::vector<uint64_t> packed(wordsPerRow * mHeight);
+	if (!readPacked(packed.data(), wordsPerRow))
+		return false;
+
+	const int height = mHeight;
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height; y++)
+	{
+		const uint64_t* words = packed.data() + y * wordsPerRow;
+		bool* cells = world->getRow(y);
+		for (unsigned int x = 0; x < mWidth; x++)
+			cells[x] = (words[x / 64] >> (x % 64)) & 1;
+	}
+	return true;
+}
+
+bool GOLFile::readPacked(uint64_t* packed, size_t wordsPerRow)
+{
+	const int height = mHeight;
+	const size_t fileWordsPerRow = (mWidth + 63) / 64;
+	const uint64_t mask = lastWordMask(mWidth);
+	mErrorRow = -1;
+	switch (mFormat)
+	{
+	case Format::TEXT:
+		return readTextPacked(packed, wordsPerRow);
+	case Format::RLE:
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < height; y++)
+			std::memcpy(packed + y * wordsPerRow, mDecoded.data() + y * fileWordsPerRow, fileWordsPerRow * sizeof(uint64_t));
+		return true;
+	case Format::PACKED:
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < height; y++)
+		{
+			uint64_t* words = packed + y * wordsPerRow;
+			std::memcpy(words, mData + mFirstRow + y * mRowStride, mRowStride);
+			words[fileWordsPerRow - 1] &= mask;
+		}
+		return true;
+	default:
+	{
+		const int blocks = (int)mBlockSizes.size();
+#pragma omp parallel for schedule(dynamic)
+		for (int block = 0; block < blocks; block++)
+			decompressBlock(block, packed, wordsPerRow);
+		return mErrorRow < 0;
+	}
+	}
+}
+
+bool GOLFile::decompressBlock(unsigned int block, uint64_t* packed, size_t wordsPerRow)
+{
+	const uint8_t* in = (const uint8_t*)mData + mBlockOffsets[block];
+	const uint8_t* end = in + mBlockSizes[block];
+	const size_t fileWordsPerRow = (mWidth + 63) / 64;
+	const size_t firstRow = (size_t)block * mBlockRows;
+	const size_t count = std::min<size_t>(mBlockRows, mHeight - firstRow) * fileWordsPerRow;
+	const uint64_t mask = lastWordMask(mWidth);
+
+	size_t i = 0;
+	while (i < count)
+	{
+		uint64_t zeros, literals;
+		if (!readVarint(in, end, zeros) || !readVarint(in, end, literals) || zeros > count - i || literals > count - i - zeros
+			|| literals > (size_t)(end - in) / sizeof(uint64_t))
+		{
+			reportRow(block, "Malformed binary board: block " + std::to_string(block) + " is corrupt.");
+			return false;
+		}
+		for (size_t n = i + zeros + literals; i < n; i++)
+		{
+			uint64_t word = 0;
+			if (i >= n - literals)
+			{
+				std::memcpy(&word, in, sizeof(word));
+				in += sizeof(word);
+			}
+			size_t column = i % fileWordsPerRow;
+			if (column == fileWordsPerRow - 1)
+				word &= mask;
+			packed[(firstRow + i / fileWordsPerRow) * wordsPerRow + column] = word;
+		}
+	}
+	if (in != end)
+	{
+		reportRow(block, "Malformed binary board: block " + std::to_string(block) + " is corrupt.");
+		return false;
+	}
+	return true;
+}
+
+bool GOLFile::save(const std::string& path, const Grid* world, Format format)
+{
+	if (format == Format::AUTO)
+		format = formatFromExtension(path);
+	switch (format)
+	{
+	case Format::PACKED:
+		return saveBinary(path, world, false);
+	case Format::COMPRESSED:
+		return saveBinary(path, world, true);
+	case Format::RLE:
+		return saveRLE(path, world);
+	default:
+		return saveText(path, world);
+	}
+}
+
+/**
+ * Same bytes as writing the rows through a text mode stream (line endings of the platform).
+ */
+bool GOLFile::saveText(const std::string& path, const Grid* world)
+{
+#ifdef _WIN32
+	const char lineEnding[] = "\r\n";
+#else
+	const char lineEnding[] = "\n";
+#endif
+	const size_t lineEndingSize = sizeof(lineEnding) - 1;
+	const unsigned int width = world->getWidth();
+	const int height = world->getHeight();
+
+	std::string header = std::to_string(width) + "," + std::to_string(height) + lineEnding;
+	const size_t rowStride = width + lineEndingSize;
+	const size_t size = header.size() + rowStride * height;
+	std::unique_ptr<char[]> buffer(new char[size]);
+	std::memcpy(buffer.get(), header.data(), header.size());
+
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height; y++)
+	{
+		const bool* cells = world->getRow(y);
+		char* row = buffer.get() + header.size() + y * rowStride;
+
+		// 16 cells at once: dead ^ (alive ^ dead) where the cell is set.
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i dead = _mm_set1_epi8(DEAD);
+		const __m128i difference = _mm_set1_epi8(ALIVE ^ DEAD);
+		unsigned int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i alive = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cells + x)), zero), difference);
+			_mm_storeu_si128((__m128i*)(row + x), _mm_xor_si128(dead, alive));
+		}
+		for (; x < width; x++)
+			row[x] = cells[x] ? ALIVE : DEAD;
+		std::memcpy(row + width, lineEnding, lineEndingSize);
+	}
+
+	std::FILE* output = std::fopen(path.c_str(), "wb");
+	if (output == nullptr)
+		return false;
+	bool written = std::fwrite(buffer.get(), 1, size, output) == size;
+	return std::fclose(output) == 0 && written;
+}
+
+// 64 cells per word, padding bits stay zero.
+void GOLFile::packRow(const bool* cells, unsigned int width, uint64_t* words)
+{
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int x = 0;
+	for (; x + 64 <= width; x += 64)
+	{
+		uint64_t word = 0;
+		for (unsigned int i = 0; i < 64; i += 16)
+		{
+			uint64_t dead = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cells + x + i)), zero));
+			word |= (dead ^ 0xFFFF) << i;
+		}
+		words[x / 64] = word;
+	}
+	if (x < width)
+	{
+		uint64_t word = 0;
+		for (unsigned int i = 0; x + i < width; i++)
+			word |= (uint64_t)cells[x + i] << i;
+		words[x / 64] = word;
+	}
+}
+
+bool GOLFile::saveBinary(const std::string& path, const Grid* world, bool compressed)
+{
+	const unsigned int width = world->getWidth();
+	const int height = world->getHeight();
+	const size_t wordsPerRow = (width + 63) / 64;
+	BinaryHeader header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.width = width;
+	header.height = height;
+	header.compressed = compressed;
+	header.blockRows = compressed ? BLOCK_ROWS : 0;
+
+	std::FILE* output = std::fopen(path.c_str(), "wb");
+	if (output == nullptr)
+		return false;
+	bool written;
+	if (!compressed)
+	{
+		// Header and rows in one buffer.
+		const size_t headerWords = sizeof(header) / sizeof(uint64_t);
+		std::unique_ptr<uint64_t[]> buffer(new uint64_t[headerWords + wordsPerRow * height]);
+		std::memcpy(buffer.get(), &header, sizeof(header));
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < height; y++)
+			packRow(world->getRow(y), width, buffer.get() + headerWords + y * wordsPerRow);
+		size_t size = (headerWords + wordsPerRow * height) * sizeof(uint64_t);
+		written = std::fwrite(buffer.get(), 1, size, output) == size;
+	}
+	else
+	{
+		const int blocks = (height + BLOCK_ROWS - 1) / BLOCK_ROWS;
+		std::vector<std::vector<uint8_t>> data(blocks);
+		std::vector<uint64_t> sizes(blocks);
+#pragma omp parallel
+		{
+			std::vector<uint64_t> words(BLOCK_ROWS * wordsPerRow);
+#pragma omp for schedule(dynamic)
+			for (int block = 0; block < blocks; block++)
+			{
+				int firstRow = block * BLOCK_ROWS;
+				int rows = std::min<int>(BLOCK_ROWS, height - firstRow);
+				for (int y = 0; y < rows; y++)
+					packRow(world->getRow(firstRow + y), width, words.data() + y * wordsPerRow);
+				compressWords(words.data(), rows * wordsPerRow, data[block]);
+				sizes[block] = data[block].size();
+			}
+		}
+		written = std::fwrite(&header, sizeof(header), 1, output) == 1 && std::fwrite(sizes.data(), sizeof(uint64_t), blocks, output) == (size_t)blocks;
+		for (int block = 0; block < blocks && written; block++)
+			written = std::fwrite(data[block].data(), 1, data[block].size(), output) == data[block].size();
+	}
+	return std::fclose(output) == 0 && written;
+}
+
+/**
+ * Dead cells at the end of a row and empty rows at the end are left out, lines are at most 70 characters.
+ */
+bool GOLFile::saveRLE(const std::string& path, const Grid* world)
+{
+	const unsigned int width = world->getWidth();
+	const unsigned int height = world->getHeight();
+	std::string output = "x = " + std::to_string(width) + ", y = " + std::to_string(height) + ", rule = " + Rule::getActive().toString() + "\n";
+	size_t lineLength = 0;
+	auto run = [&](unsigned int count, char tag)
+	{
+		// <count><tag>, the count is left out for single cells.
+		char token[16];
+		size_t length = 0;
+		if (count > 1)
+		{
+			char digits[10];
+			int n = 0;
+			for (; count > 0; count /= 10)
+				digits[n++] = (char)('0' + count % 10);
+			while (n > 0)
+				token[length++] = digits[--n];
+		}
+		token[length++] = tag;
+		if (lineLength + length > 70)
+		{
+			output += '\n';
+			lineLength = 0;
+		}
+		output.append(token, length);
+		lineLength += length;
+	};
+
+	unsigned int endedRows = 0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const bool* cells = world->getRow(y);
+		unsigned int x = 0;
+		while (x < width)
+		{
+			unsigned int start = x;
+			bool alive = cells[x];
+			while (x < width && cells[x] == alive)
+				x++;
+			if (!alive && x == width)
+				break;
+			if (endedRows > 0)
+			{
+				run(endedRows, '$');
+				endedRows = 0;
+			}
+			run(x - start, alive ? 'o' : 'b');
+		}
+		endedRows++;
+	}
+	run(1, '!');
+	output += '\n';
+
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	bool written = std::fwrite(output.data(), 1, output.size(), file) == output.size();
+	return std::fclose(file) == 0 && written;
+}
+
+/**
+ * Check that the row is inside the file, only has 'x' and '.' and ends where expected.
+ */
+bool GOLFile::validateRow(unsigned int y, const char* row)
+{
+	size_t start = row - mData;
+	if (start + mWidth > mSize)
+	{
+		reportRow(y, "Malformed input in line " + std::to_string(y + 2) + ": file ends before the row is complete (expected " + std::to_string(mHeight) + " rows of " + std::to_string(mWidth) + " cells).");
+		return false;
+	}
+
+	const __m128i alive = _mm_set1_epi8(ALIVE);
+	const __m128i dead = _mm_set1_epi8(DEAD);
+	unsigned int x = 0;
+	int invalid = 0;
+	for (; x + 16 <= mWidth; x += 16)
+	{
+		__m128i characters = _mm_loadu_si128((const __m128i*)(row + x));
+		invalid |= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(characters, alive), _mm_cmpeq_epi8(characters, dead))) ^ 0xFFFF;
+	}
+	for (; x < mWidth; x++)
+		invalid |= row[x] != ALIVE && row[x] != DEAD;
+	if (invalid)
+	{
+		reportRow(y, "Malformed input in line " + std::to_string(y + 2) + ": row has fewer cells than the width " + std::to_string(mWidth) + " or characters other than 'x' and '.'.");
+		return false;
+	}
+
+	// Line ending (the last row may end with the file).
+	size_t end = start + mWidth;
+	size_t lineEnding = mRowStride - mWidth;
+	bool atEnd = end == mSize;
+	bool lineEnds = end + lineEnding <= mSize && mData[end + lineEnding - 1] == '\n' && (lineEnding == 1 || mData[end] == '\r');
+	if (!lineEnds && !(atEnd && y == mHeight - 1))
+	{
+		reportRow(y, "Malformed input in line " + std::to_string(y + 2) + ": row has more cells than the width " + std::to_string(mWidth) + " or a different line ending.");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Remember the first malformed row or block (they are checked in parallel).
+ */
+void GOLFile::reportRow(unsigned int y, const std::string& message)
+{
+#pragma omp critical(GOLFileError)
+	{
+		if (mErrorRow < 0 || y < mErrorRow)
+		{
+			mErrorRow = y;
+			mError = message;
+		}
+	}
+}
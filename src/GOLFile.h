@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Grid.h"
+#include "Rule.h"
+
+/**
+ * Memory-mapped board file. Rows are converted in parallel straight into the layout of an engine
+ * and validated on the way.
+ *
+ * TEXT (.gol):        "<width>,<height>", then one line per row with 'x' (alive) or '.' (dead).
+ * PACKED (.golb):     32 byte header, then 64 cells per little-endian word, rows padded to whole words.
+ * COMPRESSED (.golz): same header, a table with the size of every block of BLOCK_ROWS rows, then the
+ *                     blocks as runs of zero words and literal words. Blocks are (de)compressed in parallel.
+ * RLE (.rle):         the run length encoding used by most Life programs, including the rule.
+ */
+class GOLFile
+{
+public:
+	static constexpr char ALIVE = 'x';
+	static constexpr char DEAD = '.';
+	static constexpr unsigned int BLOCK_ROWS = 64;
+
+	enum class Format
+	{
+		AUTO, TEXT, PACKED, COMPRESSED, RLE
+	};
+	// Format for a name ("gol", "golb", "golz", "rle" or "auto"), false if unknown.
+	static bool parseFormat(const std::string& name, Format& format);
+
+	GOLFile() {}
+	~GOLFile();
+	GOLFile(const GOLFile&) = delete;
+	GOLFile& operator=(const GOLFile&) = delete;
+
+	// AUTO picks the format from the header of binary files and otherwise from the file extension.
+	bool open(const std::string& path, Format format = Format::AUTO);
+	void close();
+
+	unsigned int getWidth() const { return mWidth; }
+	unsigned int getHeight() const { return mHeight; }
+	const std::string& getError() const { return mError; }
+	// Rule stored in the file (RLE only).
+	bool hasRule() const { return mHasRule; }
+	const Rule& getRule() const { return mRule; }
+
+	// One bool per cell.
+	bool readInto(Grid* world);
+	// 64 cells per word, bit b of word w is the cell at x = w * 64 + b.
+	bool readPacked(uint64_t* packed, size_t wordsPerRow);
+
+	// Format all rows in parallel and write them with a single write. AUTO uses the file extension.
+	// RLE files store the active rule.
+	static bool save(const std::string& path, const Grid* world, Format format = Format::AUTO);
+
+private:
+	static Format formatFromExtension(const std::string& path);
+	bool openText();
+	bool openBinary();
+	bool openRLE();
+	bool readTextInto(Grid* world);
+	bool readTextPacked(uint64_t* packed, size_t wordsPerRow);
+	bool decompressBlock(unsigned int block, uint64_t* packed, size_t wordsPerRow);
+
+	static void packRow(const bool* cells, unsigned int width, uint64_t* words);
+	static bool saveText(const std::string& path, const Grid* world);
+	static bool saveBinary(const std::string& path, const Grid* world, bool compressed);
+	static bool saveRLE(const std::string& path, const Grid* world);
+
+	bool validateRow(unsigned int y, const char* row);
+	void reportRow(unsigned int y, const std::string& message);
+
+	const char* mData = nullptr;
+	size_t mSize = 0;
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#endif
+
+	Format mFormat = Format::TEXT;
+	unsigned int mWidth = 0;
+	unsigned int mHeight = 0;
+	// Offset of the first row and distance between rows (width plus line ending).
+	size_t mFirstRow = 0;
+	size_t mRowStride = 0;
+	// Start of every compressed block (relative to the file) and its size.
+	std::vector<size_t> mBlockOffsets;
+	std::vector<size_t> mBlockSizes;
+	unsigned int mBlockRows = 0;
+	// RLE is decoded into packed rows while opening.
+	std::vector<uint64_t> mDecoded;
+	Rule mRule;
+	bool mHasRule = false;
+
+	std::string mError;
+	long long mErrorRow = -1;
+};
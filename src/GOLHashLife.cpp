@@ -0,0 +1,474 @@
+#include "GOLHashLife.h"
+#include "GOLBitPacked.h"
+#include "GOLSingleThread.h"
+#include "Rule.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+
+// Single cells are not hash-consed, there are only two of them.
+static HashLifeNode deadCell{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0, false, false };
+static HashLifeNode aliveCell{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0, true, false };
+
+// Hash table of all canonical nodes (chained through HashLifeNode::next).
+static std::vector<HashLifeNode*> table(1 << 16, nullptr);
+static size_t nodeCount;
+static size_t maxNodes;
+
+// Canonical empty node per level.
+static std::vector<HashLifeNode*> emptyNodes;
+// All 4x4 nodes by cell pattern, filled on demand while building.
+static std::vector<HashLifeNode*> level2Nodes(1 << 16, nullptr);
+// Memoized results of steps smaller than 2^(level - 2), per step log.
+static std::vector<std::unordered_map<HashLifeNode*, HashLifeNode*> > slowResults;
+static size_t slowResultCount;
+
+static HashLifeNode* root;
+static int rootLevel;
+static unsigned int worldWidth;
+static unsigned int worldHeight;
+// Power-of-two boards are simulated as an exact torus, others as a pattern on an infinite plane.
+static bool torus;
+
+static inline size_t hashChildren(const HashLifeNode* nw, const HashLifeNode* ne, const HashLifeNode* sw, const HashLifeNode* se)
+{
+	uint64_t h = (uint64_t)(uintptr_t)nw;
+	h = h * 0x9E3779B97F4A7C15ULL + (uint64_t)(uintptr_t)ne;
+	h = h * 0x9E3779B97F4A7C15ULL + (uint64_t)(uintptr_t)sw;
+	h = h * 0x9E3779B97F4A7C15ULL + (uint64_t)(uintptr_t)se;
+	return (size_t)(h ^ (h >> 29));
+}
+
+static inline bool isPowerOfTwo(unsigned int value)
+{
+	return value != 0 && (value & (value - 1)) == 0;
+}
+
+void GOLHashLife::setup(const Grid* world, size_t nodeLimit)
+{
+	// Results of an earlier board must not be reused.
+	clear();
+	maxNodes = nodeLimit;
+	worldWidth = world->getWidth();
+	worldHeight = world->getHeight();
+	torus = isPowerOfTwo(worldWidth) && isPowerOfTwo(worldHeight);
+
+	rootLevel = 1;
+	while ((1ULL << rootLevel) < std::max(worldWidth, worldHeight))
+		rootLevel++;
+
+	// A torus with smaller width or height is repeated until the root is square.
+	root = build(world, rootLevel, 0, 0, torus);
+}
+
+Grid* GOLHashLife::runGenerations(Grid* world, Grid* newWorld, unsigned int generations)
+{
+	unsigned long long remaining = generations;
+	// Garbage is only collected between steps, so steps get smaller while they create too many nodes.
+	int maxStepLog = 0;
+	while (remaining > 0)
+	{
+		// Largest power of two step allowed.
+		unsigned long long limit = std::min(remaining, 1ULL << maxStepLog);
+		if (!torus)
+		{
+			// The pattern behaves as on the torus as long as it never touches the border.
+			// Cells spread at most one cell per generation, so keep one cell of margin after the step.
+			long long minX, minY, maxX, maxY;
+			if (!boundingBox(root, 0, 0, minX, minY, maxX, maxY))
+				break;
+			long long margin = std::min(std::min(minX, minY), std::min((long long)worldWidth - 1 - maxX, (long long)worldHeight - 1 - maxY));
+			if (margin < 2)
+			{
+				// The bit-packed engine only computes B3/S23.
+				const bool conway = Rule::getActive().isConway();
+				std::cerr << "HashLife: pattern reaches the border of a board that is not a power of two, "
+					<< "finishing the remaining " << remaining << " generations with the " << (conway ? "bit-packed" : "sequential") << " engine." << std::endl;
+				newWorld->clear();
+				write(root, newWorld, 0, 0);
+				if (!conway)
+					return GOLSingleThread::runGenerations(newWorld, world, (unsigned int)remaining);
+				GOLBitPacked::setup(newWorld);
+				return GOLBitPacked::runGenerations(newWorld, world, (unsigned int)remaining);
+			}
+			limit = std::min(limit, std::min((unsigned long long)margin - 1, 1ULL << (rootLevel - 1)));
+		}
+		int stepLog = 0;
+		while ((2ULL << stepLog) <= limit)
+			stepLog++;
+
+		if (torus)
+		{
+			// The torus tiles the plane. Tile it until the node is large enough for the step
+			// (copies are shared, so this costs one node per level).
+			int levels = std::max(1, stepLog - rootLevel + 2);
+			HashLifeNode* tiled = root;
+			for (int i = 0; i < levels; i++)
+				tiled = join(tiled, tiled, tiled, tiled);
+			HashLifeNode* result = step(tiled, stepLog);
+			if (levels == 1)
+			{
+				// The center of four copies is the board shifted by half its size, shift it back the same way.
+				root = centeredSubnode(join(result, result, result, result));
+			}
+			else
+			{
+				// The result starts at a multiple of the board size, any aligned copy is the board.
+				root = result;
+				while (root->level > rootLevel)
+					root = root->nw;
+			}
+		}
+		else
+		{
+			// Surround root with empty space, the result is the area of root again.
+			HashLifeNode* empty = emptyNode(rootLevel - 1);
+			HashLifeNode* expanded = join(
+				join(empty, empty, empty, root->nw), join(empty, empty, root->ne, empty),
+				join(empty, root->sw, empty, empty), join(root->se, empty, empty, empty));
+			root = step(expanded, stepLog);
+		}
+		remaining -= 1ULL << stepLog;
+
+		if (nodeCount + slowResultCount > maxNodes)
+		{
+			collectGarbage();
+			maxStepLog = std::max(0, maxStepLog - 1);
+		}
+		else if (nodeCount + slowResultCount < maxNodes / 2)
+			maxStepLog = std::min(62, maxStepLog + 1);
+	}
+
+	newWorld->clear();
+	write(root, newWorld, 0, 0);
+	return newWorld;
+}
+
+/**
+ * Get the canonical node with these children.
+ */
+HashLifeNode* GOLHashLife::join(HashLifeNode* nw, HashLifeNode* ne, HashLifeNode* sw, HashLifeNode* se)
+{
+	size_t bucket = hashChildren(nw, ne, sw, se) & (table.size() - 1);
+	for (HashLifeNode* node = table[bucket]; node != nullptr; node = node->next)
+	{
+		if (node->nw == nw && node->ne == ne && node->sw == sw && node->se == se)
+			return node;
+	}
+
+	HashLifeNode* node = new HashLifeNode{ nw, ne, sw, se, table[bucket], nullptr, nw->level + 1, false, false };
+	table[bucket] = node;
+	nodeCount++;
+	if (nodeCount > table.size())
+		resizeTable();
+	return node;
+}
+
+HashLifeNode* GOLHashLife::emptyNode(int level)
+{
+	if (emptyNodes.empty())
+		emptyNodes.push_back(&deadCell);
+	while ((int)emptyNodes.size() <= level)
+	{
+		HashLifeNode* child = emptyNodes.back();
+		emptyNodes.push_back(join(child, child, child, child));
+	}
+	return emptyNodes[level];
+}
+
+/**
+ * Center of a node, one level smaller.
+ */
+HashLifeNode* GOLHashLife::centeredSubnode(HashLifeNode* node)
+{
+	return join(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+/**
+ * Center of the node (one level smaller) after 2^stepLog generations, with stepLog <= level - 2.
+ */
+HashLifeNode* GOLHashLife::step(HashLifeNode* node, int stepLog)
+{
+	const int level = node->level;
+	if (node == emptyNode(level))
+		return emptyNode(level - 1);
+
+	const bool fullStep = stepLog == level - 2;
+	if (fullStep && node->result != nullptr)
+		return node->result;
+	if (!fullStep)
+	{
+		if ((int)slowResults.size() <= stepLog)
+			slowResults.resize(stepLog + 1);
+		auto it = slowResults[stepLog].find(node);
+		if (it != slowResults[stepLog].end())
+			return it->second;
+	}
+
+	HashLifeNode* result;
+	if (level == 2)
+		result = stepLevel2(node);
+	else
+	{
+		// Nine overlapping nodes of half the size.
+		HashLifeNode* n00 = node->nw;
+		HashLifeNode* n01 = join(node->nw->ne, node->ne->nw, node->nw->se, node->ne->sw);
+		HashLifeNode* n02 = node->ne;
+		HashLifeNode* n10 = join(node->nw->sw, node->nw->se, node->sw->nw, node->sw->ne);
+		HashLifeNode* n11 = centeredSubnode(node);
+		HashLifeNode* n12 = join(node->ne->sw, node->ne->se, node->se->nw, node->se->ne);
+		HashLifeNode* n20 = node->sw;
+		HashLifeNode* n21 = join(node->sw->ne, node->se->nw, node->sw->se, node->se->sw);
+		HashLifeNode* n22 = node->se;
+
+		// Full step: advance twice by half the time. Otherwise: only the last part advances.
+		HashLifeNode* r[9];
+		HashLifeNode* parts[9]{ n00, n01, n02, n10, n11, n12, n20, n21, n22 };
+		for (int i = 0; i < 9; i++)
+			r[i] = fullStep ? step(parts[i], level - 3) : centeredSubnode(parts[i]);
+
+		int nextLog = fullStep ? level - 3 : stepLog;
+		result = join(
+			step(join(r[0], r[1], r[3], r[4]), nextLog),
+			step(join(r[1], r[2], r[4], r[5]), nextLog),
+			step(join(r[3], r[4], r[6], r[7]), nextLog),
+			step(join(r[4], r[5], r[7], r[8]), nextLog));
+	}
+
+	if (fullStep)
+		node->result = result;
+	else
+	{
+		slowResults[stepLog][node] = result;
+		slowResultCount++;
+	}
+	return result;
+}
+
+/**
+ * 4x4 node: compute the center 2x2 cells one generation ahead.
+ */
+HashLifeNode* GOLHashLife::stepLevel2(HashLifeNode* node)
+{
+	bool cells[4][4];
+	HashLifeNode* quadrants[2][2]{ { node->nw, node->ne }, { node->sw, node->se } };
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			HashLifeNode* quadrant = quadrants[y / 2][x / 2];
+			HashLifeNode* cell = (y % 2 == 0) ? (x % 2 == 0 ? quadrant->nw : quadrant->ne) : (x % 2 == 0 ? quadrant->sw : quadrant->se);
+			cells[y][x] = cell->alive;
+		}
+	}
+
+	const Rule& rule = Rule::getActive();
+	HashLifeNode* next[2][2];
+	for (int y = 1; y <= 2; y++)
+	{
+		for (int x = 1; x <= 2; x++)
+		{
+			int neighborsAlive = cells[y - 1][x - 1] + cells[y - 1][x] + cells[y - 1][x + 1] + cells[y][x - 1] + cells[y][x + 1] + cells[y + 1][x - 1] + cells[y + 1][x] + cells[y + 1][x + 1];
+			next[y - 1][x - 1] = rule.next(cells[y][x], neighborsAlive) ? &aliveCell : &deadCell;
+		}
+	}
+	return join(next[0][0], next[0][1], next[1][0], next[1][1]);
+}
+
+/**
+ * Build the node covering 2^level cells from (x, y). With wrap the board is repeated, otherwise surrounded by dead cells.
+ */
+HashLifeNode* GOLHashLife::build(const Grid* world, int level, long long x, long long y, bool wrap)
+{
+	if (!wrap && (x >= worldWidth || y >= worldHeight))
+		return emptyNode(level);
+
+	if (level == 2)
+	{
+		unsigned int pattern = 0;
+		for (int cy = 0; cy < 4; cy++)
+		{
+			for (int cx = 0; cx < 4; cx++)
+			{
+				long long cellX = wrap ? (x + cx) % worldWidth : x + cx;
+				long long cellY = wrap ? (y + cy) % worldHeight : y + cy;
+				if (cellX < worldWidth && cellY < worldHeight && world->getRow((int)cellY)[cellX])
+					pattern |= 1u << (cy * 4 + cx);
+			}
+		}
+		HashLifeNode*& node = level2Nodes[pattern];
+		if (node == nullptr)
+		{
+			HashLifeNode* cells[16];
+			for (int i = 0; i < 16; i++)
+				cells[i] = (pattern >> i) & 1 ? &aliveCell : &deadCell;
+			node = join(
+				join(cells[0], cells[1], cells[4], cells[5]), join(cells[2], cells[3], cells[6], cells[7]),
+				join(cells[8], cells[9], cells[12], cells[13]), join(cells[10], cells[11], cells[14], cells[15]));
+		}
+		return node;
+	}
+	if (level < 2)
+	{
+		// Only for boards smaller than 4x4.
+		if (level == 0)
+		{
+			long long cellX = wrap ? x % worldWidth : x;
+			long long cellY = wrap ? y % worldHeight : y;
+			return cellX < worldWidth && cellY < worldHeight && world->getRow((int)cellY)[cellX] ? &aliveCell : &deadCell;
+		}
+		return join(build(world, 0, x, y, wrap), build(world, 0, x + 1, y, wrap), build(world, 0, x, y + 1, wrap), build(world, 0, x + 1, y + 1, wrap));
+	}
+
+	long long half = 1LL << (level - 1);
+	return join(
+		build(world, level - 1, x, y, wrap), build(world, level - 1, x + half, y, wrap),
+		build(world, level - 1, x, y + half, wrap), build(world, level - 1, x + half, y + half, wrap));
+}
+
+/**
+ * Write the alive cells of the node at (x, y) into the (cleared) grid.
+ */
+void GOLHashLife::write(HashLifeNode* node, Grid* world, long long x, long long y)
+{
+	if (x >= worldWidth || y >= worldHeight || node == emptyNode(node->level))
+		return;
+	if (node->level == 0)
+	{
+		world->getRow((int)y)[x] = true;
+		return;
+	}
+	long long half = 1LL << (node->level - 1);
+	write(node->nw, world, x, y);
+	write(node->ne, world, x + half, y);
+	write(node->sw, world, x, y + half);
+	write(node->se, world, x + half, y + half);
+}
+
+/**
+ * Extend the bounding box by the alive cells of the node at (x, y). Returns false if there are none.
+ */
+bool GOLHashLife::boundingBox(HashLifeNode* node, long long x, long long y, long long& minX, long long& minY, long long& maxX, long long& maxY)
+{
+	if (node == emptyNode(node->level))
+		return false;
+	if (node->level == 0)
+	{
+		minX = maxX = x;
+		minY = maxY = y;
+		return true;
+	}
+
+	long long half = 1LL << (node->level - 1);
+	HashLifeNode* children[4]{ node->nw, node->ne, node->sw, node->se };
+	bool found = false;
+	for (int i = 0; i < 4; i++)
+	{
+		long long childMinX, childMinY, childMaxX, childMaxY;
+		if (!boundingBox(children[i], x + (i % 2) * half, y + (i / 2) * half, childMinX, childMinY, childMaxX, childMaxY))
+			continue;
+		minX = found ? std::min(minX, childMinX) : childMinX;
+		minY = found ? std::min(minY, childMinY) : childMinY;
+		maxX = found ? std::max(maxX, childMaxX) : childMaxX;
+		maxY = found ? std::max(maxY, childMaxY) : childMaxY;
+		found = true;
+	}
+	return found;
+}
+
+/**
+ * Free every node not reachable from the root. Memoized results pointing to freed nodes are dropped.
+ */
+void GOLHashLife::clear()
+{
+	for (HashLifeNode*& bucket : table)
+	{
+		while (bucket != nullptr)
+		{
+			HashLifeNode* node = bucket;
+			bucket = node->next;
+			delete node;
+		}
+	}
+	nodeCount = 0;
+	emptyNodes.clear();
+	std::fill(level2Nodes.begin(), level2Nodes.end(), nullptr);
+	slowResults.clear();
+	slowResultCount = 0;
+}
+
+void GOLHashLife::collectGarbage()
+{
+	mark(root);
+	for (HashLifeNode* node : emptyNodes)
+		mark(node);
+	for (HashLifeNode* node : level2Nodes)
+	{
+		if (node != nullptr)
+			mark(node);
+	}
+
+	for (HashLifeNode* bucket : table)
+	{
+		for (HashLifeNode* node = bucket; node != nullptr; node = node->next)
+		{
+			if (node->marked && node->result != nullptr && !node->result->marked)
+				node->result = nullptr;
+		}
+	}
+
+	for (HashLifeNode*& bucket : table)
+	{
+		HashLifeNode** link = &bucket;
+		while (*link != nullptr)
+		{
+			HashLifeNode* node = *link;
+			if (node->marked)
+				link = &node->next;
+			else
+			{
+				*link = node->next;
+				delete node;
+				nodeCount--;
+			}
+		}
+	}
+	slowResults.clear();
+	slowResultCount = 0;
+
+	for (HashLifeNode* bucket : table)
+	{
+		for (HashLifeNode* node = bucket; node != nullptr; node = node->next)
+			node->marked = false;
+	}
+}
+
+void GOLHashLife::mark(HashLifeNode* node)
+{
+	if (node->level == 0 || node->marked)
+		return;
+	node->marked = true;
+	mark(node->nw);
+	mark(node->ne);
+	mark(node->sw);
+	mark(node->se);
+}
+
+void GOLHashLife::resizeTable()
+{
+	std::vector<HashLifeNode*> resized(table.size() * 2, nullptr);
+	for (HashLifeNode* bucket : table)
+	{
+		HashLifeNode* node = bucket;
+		while (node != nullptr)
+		{
+			HashLifeNode* next = node->next;
+			size_t index = hashChildren(node->nw, node->ne, node->sw, node->se) & (resized.size() - 1);
+			node->next = resized[index];
+			resized[index] = node;
+			node = next;
+		}
+	}
+	table.swap(resized);
+}
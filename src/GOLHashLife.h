@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "Grid.h"
+
+/**
+ * Quadtree node. Nodes are canonical (hash-consed): equal subtrees are the same node.
+ * Level 0 nodes are single cells, a node of level k covers 2^k x 2^k cells.
+ */
+struct HashLifeNode
+{
+	HashLifeNode* nw;
+	HashLifeNode* ne;
+	HashLifeNode* sw;
+	HashLifeNode* se;
+	// Next node in the same hash bucket.
+	HashLifeNode* next;
+	// Memoized center after 2^(level - 2) generations.
+	HashLifeNode* result;
+	int level;
+	bool alive;
+	bool marked;
+};
+
+class GOLHashLife
+{
+public:
+	static void setup(const Grid* world, size_t nodeLimit);
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations);
+
+private:
+	static HashLifeNode* join(HashLifeNode* nw, HashLifeNode* ne, HashLifeNode* sw, HashLifeNode* se);
+	static HashLifeNode* emptyNode(int level);
+	static HashLifeNode* centeredSubnode(HashLifeNode* node);
+	static HashLifeNode* step(HashLifeNode* node, int stepLog);
+	static HashLifeNode* stepLevel2(HashLifeNode* node);
+
+	static HashLifeNode* build(const Grid* world, int level, long long x, long long y, bool wrap);
+	static void write(HashLifeNode* node, Grid* world, long long x, long long y);
+	static bool boundingBox(HashLifeNode* node, long long x, long long y, long long& minX, long long& minY, long long& maxX, long long& maxY);
+
+	static void clear();
+	static void collectGarbage();
+	static void mark(HashLifeNode* node);
+	static void resizeTable();
+};
@@ -0,0 +1,167 @@
+#include "GOLLookup.h"
+#include "Rule.h"
+#include "../util/Timing.h"
+#include <cstring>
+
+// Bit 4 * r + c of the index is the cell in row r and column c of a 4x4 neighborhood.
+// Bit 2 * r + c of the entry is the next state of cell (c + 1, r + 1).
+static uint8_t table[65536];
+
+static unsigned int worldWidth;
+static unsigned int worldHeight;
+// Words with cells (x < width) and words per row including the halo words in front and behind.
+static unsigned int cellWords;
+static unsigned int stride;
+static uint64_t lastWordMask;
+
+// Rows -1 to height + 1 (the last for odd heights, which compute a pair of rows past the end).
+static uint64_t* board = nullptr;
+static uint64_t* newBoard = nullptr;
+
+void GOLLookup::setup(const Grid* world)
+{
+	worldWidth = world->getWidth();
+	worldHeight = world->getHeight();
+	cellWords = (worldWidth + 63) / 64;
+	// Cells up to x = width + 1 are read past the end (wrap around), then one word behind the last one read.
+	stride = 1 + (worldWidth + 2 + 63) / 64 + 1;
+	lastWordMask = worldWidth % 64 == 0 ? ~0ULL : (1ULL << (worldWidth % 64)) - 1;
+
+	delete[] board;
+	delete[] newBoard;
+	board = new uint64_t[(size_t)stride * (worldHeight + 3)]();
+	newBoard = new uint64_t[(size_t)stride * (worldHeight + 3)]();
+	for (unsigned int y = 0; y < worldHeight; y++)
+	{
+		const bool* cells = world->getRow(y);
+		uint64_t* row = getRow(board, y);
+		for (unsigned int x = 0; x < worldWidth; x++)
+			row[x / 64] |= (uint64_t)cells[x] << (x % 64);
+	}
+	buildTable();
+}
+
+/**
+ * Apply the active rule to the center of every 4x4 neighborhood.
+ */
+void GOLLookup::buildTable()
+{
+	const Rule& rule = Rule::getActive();
+	for (unsigned int index = 0; index < 65536; index++)
+	{
+		uint8_t entry = 0;
+		for (int y = 1; y <= 2; y++)
+		{
+			for (int x = 1; x <= 2; x++)
+			{
+				int neighborsAlive = 0;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						if (dx != 0 || dy != 0)
+							neighborsAlive += (index >> (4 * (y + dy) + x + dx)) & 1;
+					}
+				}
+				bool alive = (index >> (4 * y + x)) & 1;
+				entry |= (uint8_t)rule.next(alive, neighborsAlive) << (2 * (y - 1) + x - 1);
+			}
+		}
+		table[index] = entry;
+	}
+}
+
+uint64_t* GOLLookup::getRow(uint64_t* board, int y)
+{
+	return board + (size_t)(y + 1) * stride + 1;
+}
+
+/**
+ * Wrap around: word -1 holds the cell at x = width - 1 in bit 63, x = width and width + 1 are the cells 0 and 1.
+ * Rows -1, height and height + 1 are copies of the rows height - 1, 0 and 1.
+ */
+void GOLLookup::refreshHalo(uint64_t* board)
+{
+	const unsigned int second = 1 % worldWidth;
+	for (unsigned int y = 0; y < worldHeight; y++)
+	{
+		uint64_t* row = getRow(board, y);
+		row[-1] = ((row[(worldWidth - 1) / 64] >> ((worldWidth - 1) % 64)) & 1) << 63;
+		uint64_t first = row[0] & 1;
+		uint64_t next = (row[second / 64] >> (second % 64)) & 1;
+		unsigned int x = worldWidth;
+		row[x / 64] = (row[x / 64] & ~(1ULL << (x % 64))) | (first << (x % 64));
+		x++;
+		row[x / 64] = (row[x / 64] & ~(1ULL << (x % 64))) | (next << (x % 64));
+	}
+	std::memcpy(getRow(board, -1) - 1, getRow(board, worldHeight - 1) - 1, stride * sizeof(uint64_t));
+	std::memcpy(getRow(board, worldHeight) - 1, getRow(board, 0) - 1, stride * sizeof(uint64_t));
+	std::memcpy(getRow(board, worldHeight + 1) - 1, getRow(board, 1 % worldHeight) - 1, stride * sizeof(uint64_t));
+}
+
+Grid* GOLLookup::runGenerations(Grid* /* world */, Grid* newWorld, unsigned int generations)
+{
+	const unsigned int last = cellWords - 1;
+	uint64_t* temp;
+	for (unsigned int i = 0; i < generations; i++)
+	{
+		Timing::Scope generation("generation", true);
+		refreshHalo(board);
+
+		for (int y = 0; y < (int)worldHeight; y += 2)
+		{
+			const uint64_t* rows[4]{ getRow(board, y - 1), getRow(board, y), getRow(board, y + 1), getRow(board, y + 2) };
+			uint64_t* newRow = getRow(newBoard, y);
+			// Odd heights: the second row of the last pair is row height, which is not kept.
+			uint64_t* newRowBelow = getRow(newBoard, y + 1);
+
+			for (int w = 0; w < (int)cellWords; w++)
+			{
+				// The rows seen one cell further left: bit b is the cell at x = w * 64 + b - 1.
+				uint64_t low[4];
+				uint64_t high[4];
+				for (int r = 0; r < 4; r++)
+				{
+					low[r] = (rows[r][w] << 1) | (rows[r][w - 1] >> 63);
+					high[r] = (rows[r][w + 1] << 1) | (rows[r][w] >> 63);
+				}
+
+				uint64_t above = 0;
+				uint64_t below = 0;
+				for (unsigned int b = 0; b < 64; b += 2)
+				{
+					// The low four bits are the cells x - 1 to x + 2 of each row, where x = w * 64 + b.
+					// For the last pair, x + 1 and x + 2 come from the next word.
+					if (b == 62)
+					{
+						for (int r = 0; r < 4; r++)
+							low[r] |= high[r] << 2;
+					}
+					unsigned int index = (unsigned int)((low[0] & 0xF) | (low[1] & 0xF) << 4 | (low[2] & 0xF) << 8 | (low[3] & 0xF) << 12);
+					uint64_t entry = table[index];
+					above |= (entry & 3) << b;
+					below |= (entry >> 2) << b;
+					for (int r = 0; r < 4; r++)
+						low[r] >>= 2;
+				}
+				newRow[w] = above;
+				newRowBelow[w] = below;
+			}
+			// Clear bits past the last column.
+			newRow[last] &= lastWordMask;
+			newRowBelow[last] &= lastWordMask;
+		}
+		temp = board;
+		board = newBoard;
+		newBoard = temp;
+	}
+
+	for (unsigned int y = 0; y < worldHeight; y++)
+	{
+		const uint64_t* row = getRow(board, y);
+		bool* cells = newWorld->getRow(y);
+		for (unsigned int x = 0; x < worldWidth; x++)
+			cells[x] = (row[x / 64] >> (x % 64)) & 1;
+	}
+	return newWorld;
+}
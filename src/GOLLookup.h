@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include "Grid.h"
+
+/**
+ * Lookup table engine: a table of all 65536 4x4 neighborhoods holds the next generation of their center 2x2 cells,
+ * so two rows are advanced together and every lookup computes four cells.
+ * Rows are stored with 64 cells per word (bit b of word w is the cell at x = w * 64 + b) plus a word of halo
+ * in front and behind; the 4x4 windows are shifted out of four rows at once.
+ */
+class GOLLookup
+{
+public:
+	static void setup(const Grid* world);
+	// Continues from the last computed generation (world is not read), the result is written into newWorld.
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations);
+
+private:
+	static void buildTable();
+	static void refreshHalo(uint64_t* board);
+	static uint64_t* getRow(uint64_t* board, int y);
+};
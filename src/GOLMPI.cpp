@@ -0,0 +1,331 @@
+#ifdef GOL_MPI
+#include "GOLMPI.h"
+#include "Rule.h"
+#include "../util/Timing.h"
+#include <mpi.h>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// Directions (y, x) of the eight neighbors. 7 - d is the opposite of direction d.
+static const int DIRECTION_Y[8]{ -1, -1, -1, 0, 0, 1, 1, 1 };
+static const int DIRECTION_X[8]{ -1, 0, 1, -1, 1, -1, 0, 1 };
+
+static MPI_Comm grid = MPI_COMM_NULL;
+static int rank = 0;
+static int size = 1;
+
+static int worldWidth;
+static int worldHeight;
+static int layoutColumns;
+static int layoutRows;
+
+// Own block of the board, stored at (depth, depth) in the local buffers.
+static int blockX;
+static int blockY;
+static int blockWidth;
+static int blockHeight;
+static int depth;
+static int localWidth;
+static int localHeight;
+static bool* current = nullptr;
+static bool* next = nullptr;
+
+static int neighbors[8];
+// Edge of the own block sent to neighbor d, halo received from neighbor d.
+static MPI_Datatype sendTypes[8];
+static MPI_Datatype recvTypes[8];
+// Own block without halo.
+static MPI_Datatype blockType = MPI_DATATYPE_NULL;
+
+bool GOLMPI::init(int* argc, char*** argv)
+{
+	if (MPI_Init(argc, argv) != MPI_SUCCESS)
+	{
+		std::cerr << "Could not initialize MPI." << std::endl;
+		return false;
+	}
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	return true;
+}
+
+void GOLMPI::finalize()
+{
+	if (blockType != MPI_DATATYPE_NULL)
+	{
+		for (int d = 0; d < 8; d++)
+		{
+			MPI_Type_free(&sendTypes[d]);
+			MPI_Type_free(&recvTypes[d]);
+		}
+		MPI_Type_free(&blockType);
+	}
+	if (grid != MPI_COMM_NULL)
+		MPI_Comm_free(&grid);
+	delete[] current;
+	delete[] next;
+	current = nullptr;
+	next = nullptr;
+	MPI_Finalize();
+}
+
+int GOLMPI::getRank()
+{
+	return rank;
+}
+
+int GOLMPI::getSize()
+{
+	return size;
+}
+
+void GOLMPI::blockBounds(int column, int row, int& startX, int& startY, int& endX, int& endY)
+{
+	startX = (int)((long long)worldWidth * column / layoutColumns);
+	endX = (int)((long long)worldWidth * (column + 1) / layoutColumns);
+	startY = (int)((long long)worldHeight * row / layoutRows);
+	endY = (int)((long long)worldHeight * (row + 1) / layoutRows);
+}
+
+bool GOLMPI::setup(const Grid* world, int columns, int rows, int haloDepth)
+{
+	// Size and rule (which may come from the file) of rank 0; width 0 if loading failed.
+	int header[4]{ 0, 0, Rule::getActive().birth, Rule::getActive().survival };
+	if (rank == 0 && world)
+	{
+		header[0] = (int)world->getWidth();
+		header[1] = (int)world->getHeight();
+	}
+	MPI_Bcast(header, 4, MPI_INT, 0, MPI_COMM_WORLD);
+	if (header[0] == 0)
+		return false;
+	worldWidth = header[0];
+	worldHeight = header[1];
+	Rule::setActive(Rule((uint16_t)header[2], (uint16_t)header[3]));
+	depth = haloDepth;
+
+	// Layout: as given, otherwise the factors of the rank count closest to a square, the larger one along the longer side.
+	int dims[2]{ 0, 0 };
+	if (columns > 0 && rows > 0 && columns * rows != size)
+	{
+		if (rank == 0)
+			std::cerr << "--mpi-grid " << columns << "x" << rows << " needs " << columns * rows << " ranks, not " << size << "." << std::endl;
+		return false;
+	}
+	if ((columns > 0 && size % columns != 0) || (rows > 0 && size % rows != 0))
+	{
+		if (rank == 0)
+			std::cerr << "--mpi-grid does not divide " << size << " ranks." << std::endl;
+		return false;
+	}
+	if (columns > 0 || rows > 0)
+	{
+		layoutColumns = columns > 0 ? columns : size / rows;
+		layoutRows = rows > 0 ? rows : size / columns;
+	}
+	else
+	{
+		MPI_Dims_create(size, 2, dims);
+		layoutColumns = worldWidth >= worldHeight ? dims[0] : dims[1];
+		layoutRows = size / layoutColumns;
+	}
+
+	// Halos only come from the direct neighbors, so every block needs at least depth cells.
+	if (worldWidth / layoutColumns < depth || worldHeight / layoutRows < depth)
+	{
+		if (rank == 0)
+			std::cerr << "A " << worldWidth << "x" << worldHeight << " board split into " << layoutColumns << "x" << layoutRows
+				<< " blocks is too small for a halo depth of " << depth << "." << std::endl;
+		return false;
+	}
+
+	dims[0] = layoutRows;
+	dims[1] = layoutColumns;
+	int periods[2]{ 1, 1 };
+	MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid);
+	int coords[2];
+	MPI_Cart_coords(grid, rank, 2, coords);
+	for (int d = 0; d < 8; d++)
+	{
+		// Coordinates wrap around (periodic).
+		int neighbor[2]{ coords[0] + DIRECTION_Y[d], coords[1] + DIRECTION_X[d] };
+		MPI_Cart_rank(grid, neighbor, &neighbors[d]);
+	}
+
+	int endX, endY;
+	blockBounds(coords[1], coords[0], blockX, blockY, endX, endY);
+	blockWidth = endX - blockX;
+	blockHeight = endY - blockY;
+	localWidth = blockWidth + 2 * depth;
+	localHeight = blockHeight + 2 * depth;
+	current = new bool[(size_t)localWidth * localHeight]();
+	next = new bool[(size_t)localWidth * localHeight]();
+
+	// Edges and halos as subarrays of the local buffer.
+	int sizes[2]{ localHeight, localWidth };
+	for (int d = 0; d < 8; d++)
+	{
+		int subsizes[2]{ DIRECTION_Y[d] == 0 ? blockHeight : depth, DIRECTION_X[d] == 0 ? blockWidth : depth };
+		int sendStarts[2]{ DIRECTION_Y[d] == 1 ? blockHeight : depth, DIRECTION_X[d] == 1 ? blockWidth : depth };
+		int recvStarts[2]{ DIRECTION_Y[d] == -1 ? 0 : (DIRECTION_Y[d] == 0 ? depth : depth + blockHeight),
+			DIRECTION_X[d] == -1 ? 0 : (DIRECTION_X[d] == 0 ? depth : depth + blockWidth) };
+		MPI_Type_create_subarray(2, sizes, subsizes, sendStarts, MPI_ORDER_C, MPI_BYTE, &sendTypes[d]);
+		MPI_Type_create_subarray(2, sizes, subsizes, recvStarts, MPI_ORDER_C, MPI_BYTE, &recvTypes[d]);
+		MPI_Type_commit(&sendTypes[d]);
+		MPI_Type_commit(&recvTypes[d]);
+	}
+	int blockSizes[2]{ blockHeight, blockWidth };
+	int blockStarts[2]{ depth, depth };
+	MPI_Type_create_subarray(2, sizes, blockSizes, blockStarts, MPI_ORDER_C, MPI_BYTE, &blockType);
+	MPI_Type_commit(&blockType);
+
+	// Rank 0 sends every rank its block.
+	if (rank != 0)
+	{
+		MPI_Recv(current, 1, blockType, 0, 0, grid, MPI_STATUS_IGNORE);
+		return true;
+	}
+	for (int target = 0; target < size; target++)
+	{
+		int targetCoords[2], startX, startY;
+		MPI_Cart_coords(grid, target, 2, targetCoords);
+		blockBounds(targetCoords[1], targetCoords[0], startX, startY, endX, endY);
+		if (target == 0)
+		{
+			for (int y = startY; y < endY; y++)
+				std::memcpy(current + (size_t)(y - startY + depth) * localWidth + depth, world->getRow(y) + startX, endX - startX);
+			continue;
+		}
+		MPI_Datatype rowsType;
+		MPI_Type_vector(endY - startY, endX - startX, (int)world->getStride(), MPI_BYTE, &rowsType);
+		MPI_Type_commit(&rowsType);
+		MPI_Send(world->getRow(startY) + startX, 1, rowsType, target, 0, grid);
+		MPI_Type_free(&rowsType);
+	}
+	return true;
+}
+
+void GOLMPI::runGenerations(unsigned int generations)
+{
+	withActiveRule([&](auto rule) { runGenerations(generations, rule); });
+}
+
+template<class CellRule>
+void GOLMPI::runGenerations(unsigned int generations, CellRule rule)
+{
+	// Cells of the first step that only read the own block (empty for blocks narrower than three cells).
+	const int innerStartX = depth + 1;
+	const int innerStartY = depth + 1;
+	const int innerEndX = std::max(innerStartX, depth + blockWidth - 1);
+	const int innerEndY = std::max(innerStartY, depth + blockHeight - 1);
+
+	Timing::Duration wait{ 0 };
+	long long exchanges = 0;
+	bool* temp;
+	for (unsigned int i = 0; i < generations; i += depth)
+	{
+		const int steps = (int)std::min((unsigned int)depth, generations - i);
+
+		// Halo from all eight neighbors. Data sent towards direction d is tagged d.
+		MPI_Request requests[16];
+		for (int d = 0; d < 8; d++)
+		{
+			MPI_Irecv(current, 1, recvTypes[d], neighbors[d], 7 - d, grid, &requests[d]);
+			MPI_Isend(current, 1, sendTypes[d], neighbors[d], d, grid, &requests[8 + d]);
+		}
+		exchanges++;
+
+		computeRegion(innerStartX, innerStartY, innerEndX, innerEndY, rule);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		MPI_Waitall(16, requests, MPI_STATUSES_IGNORE);
+		wait += std::chrono::high_resolution_clock::now() - start;
+
+		// Every step the computed area shrinks by one cell, so the first one reaches steps - 1 cells into the halo.
+		int margin = steps - 1;
+		int startX = depth - margin;
+		int startY = depth - margin;
+		int endX = depth + blockWidth + margin;
+		int endY = depth + blockHeight + margin;
+		computeRegion(startX, startY, endX, innerStartY, rule);
+		computeRegion(startX, innerEndY, endX, endY, rule);
+		computeRegion(startX, innerStartY, innerStartX, innerEndY, rule);
+		computeRegion(innerEndX, innerStartY, endX, innerEndY, rule);
+		temp = current;
+		current = next;
+		next = temp;
+
+		for (int step = 2; step <= steps; step++)
+		{
+			margin = steps - step;
+			computeRegion(depth - margin, depth - margin, depth + blockWidth + margin, depth + blockHeight + margin, rule);
+			temp = current;
+			current = next;
+			next = temp;
+		}
+	}
+
+	// The slowest rank shows how uneven the blocks are.
+	double waitMs = wait.count();
+	double maxWaitMs = 0;
+	MPI_Reduce(&waitMs, &maxWaitMs, 1, MPI_DOUBLE, MPI_MAX, 0, grid);
+	if (rank == 0)
+	{
+		Timing* time = Timing::getInstance();
+		time->addRecord("halo wait", wait);
+		time->addRecord("halo wait (slowest rank)", Timing::Duration(maxWaitMs));
+		time->setCounter("ranks", size);
+		time->setCounter("halo depth", depth);
+		time->setCounter("halo exchanges", exchanges);
+	}
+}
+
+/**
+ * Compute cells [startX, endX) x [startY, endY) of the local buffers.
+ */
+template<class CellRule>
+void GOLMPI::computeRegion(int startX, int startY, int endX, int endY, CellRule rule)
+{
+	const bool* world = current;
+	bool* newWorld = next;
+	for (int y = startY; y < endY; y++)
+	{
+		const bool* above = world + (size_t)(y - 1) * localWidth;
+		const bool* row = world + (size_t)y * localWidth;
+		const bool* below = world + (size_t)(y + 1) * localWidth;
+		bool* newRow = newWorld + (size_t)y * localWidth;
+		for (int x = startX; x < endX; x++)
+		{
+			int neighborsAlive = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+			newRow[x] = rule(row[x], neighborsAlive);
+		}
+	}
+}
+
+void GOLMPI::gather(Grid* world)
+{
+	if (rank != 0)
+	{
+		MPI_Send(current, 1, blockType, 0, 1, grid);
+		return;
+	}
+	for (int source = 0; source < size; source++)
+	{
+		int sourceCoords[2], startX, startY, endX, endY;
+		MPI_Cart_coords(grid, source, 2, sourceCoords);
+		blockBounds(sourceCoords[1], sourceCoords[0], startX, startY, endX, endY);
+		if (source == 0)
+		{
+			for (int y = startY; y < endY; y++)
+				std::memcpy(world->getRow(y) + startX, current + (size_t)(y - startY + depth) * localWidth + depth, endX - startX);
+			continue;
+		}
+		MPI_Datatype rowsType;
+		MPI_Type_vector(endY - startY, endX - startX, (int)world->getStride(), MPI_BYTE, &rowsType);
+		MPI_Type_commit(&rowsType);
+		MPI_Recv(world->getRow(startY) + startX, 1, rowsType, source, 1, grid, MPI_STATUS_IGNORE);
+		MPI_Type_free(&rowsType);
+	}
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+#include "Grid.h"
+
+/**
+ * Domain decomposition over processes (build with GOL_MPI and an MPI library, run with e.g. mpirun -np 4).
+ * The torus is split into columns x rows blocks, one per rank. Every haloDepth generations each rank exchanges
+ * a halo of haloDepth cells with its eight neighbors and then advances its block haloDepth generations,
+ * computing the inner cells of the first one while the halo is still in flight.
+ * Rank 0 loads the board, sends every rank its block and collects the blocks again at the end.
+ */
+class GOLMPI
+{
+public:
+	static bool init(int* argc, char*** argv);
+	static void finalize();
+	static int getRank();
+	static int getSize();
+
+	// Rank 0 passes the loaded board (nullptr if loading failed), the other ranks nullptr.
+	// columns and rows 0 pick a layout as square as possible. Returns false on all ranks if there is no valid layout.
+	static bool setup(const Grid* world, int columns, int rows, int haloDepth);
+	static void runGenerations(unsigned int generations);
+	// Copy all blocks into world (rank 0 only, nullptr on the others).
+	static void gather(Grid* world);
+
+private:
+	template<class CellRule>
+	static void runGenerations(unsigned int generations, CellRule rule);
+	template<class CellRule>
+	static void computeRegion(int startX, int startY, int endX, int endY, CellRule rule);
+	static void blockBounds(int column, int row, int& startX, int& startY, int& endX, int& endY);
+};
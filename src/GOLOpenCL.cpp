@@ -1,38 +1,142 @@
 #include "GOLOpenCL.h"
+#include "Rule.h"
+#include "../util/Timing.h"
 #include <CL/cl.hpp>
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <algorithm>
 
-
-constexpr bool RULE_TABLE[2][9]{ {0,0,0,1,0,0,0,0,0},{0,0,1,1,0,0,0,0,0} };
-
+cl::Device device;
+cl::Context context;
 cl::Program program;
 cl::CommandQueue queue;
+// Device (indices into the platforms and their devices) and options of the built program;
+// the program is only built again when they change (e.g. another rule).
+unsigned int platformIndex = 0;
+unsigned int deviceIndex = 0;
+std::string builtOptions;
+long long cacheHits = 0;
+long long cacheMisses = 0;
 
 cl::Buffer buffer_World;
 cl::Buffer buffer_NewWorld;
 cl::Buffer buffer_Dimensions;
 
+cl::Kernel kernel_WrapColumns;
+cl::Kernel kernel_WrapRows;
+cl::Kernel kernel_ProcessCell;
+cl::Kernel kernel_ProcessTile;
+
+// Boards of a batch, one after the other (grown when a batch needs more)
+cl::Buffer buffer_BatchWorld;
+cl::Buffer buffer_BatchNewWorld;
+size_t batchCapacity = 0;
+
+// Buffers live in host memory (grids), nothing is copied
+bool zeroCopy;
+
+// Buffer holding the latest generation and the grids that receive each buffer,
+// so runs can be continued (e.g. between snapshots)
+cl::Buffer* buffer_Current;
+Grid* grid_World;
+Grid* grid_NewWorld;
+
 size_t worldSize;
+size_t cellCount;
+int worldWidth;
+int worldHeight;
 
-bool* world1D;
-bool* newWorld1D;
+void GOLOpenCL::selectDevice(unsigned int platform, unsigned int device)
+{
+	platformIndex = platform;
+	deviceIndex = device;
+}
 
-void GOLOpenCL::setup(bool** world, bool** newWorld, int width, int height)
+bool GOLOpenCL::isAvailable()
 {
-	// Convert 2D arrays to 1D
-	unsigned int size = width * height;
-	world1D = new bool[size];
-	newWorld1D = new bool[size];
-	for (unsigned int y = 0; y < height; y++)
-	{
-		unsigned int row = y * width;
-		for (unsigned int x = 0; x < width; x++)
-		{
-			world1D[row + x] = world[y][x];
-		}
+	std::vector<cl::Platform> platforms;
+	if (cl::Platform::get(&platforms) != CL_SUCCESS || platformIndex >= platforms.size())
+		return false;
+	std::vector<cl::Device> devices;
+	platforms[platformIndex].getDevices(CL_DEVICE_TYPE_ALL, &devices);
+	return deviceIndex < devices.size();
+}
+
+/**
+ * All platforms and their devices with their indices (for --cl-platform and --cl-device).
+ */
+static void listDevices(const std::vector<cl::Platform>& platforms)
+{
+	for (size_t p = 0; p < platforms.size(); p++)
+	{
+		std::cerr << "  platform " << p << ": " << platforms[p].getInfo<CL_PLATFORM_NAME>() << std::endl;
+		std::vector<cl::Device> devices;
+		platforms[p].getDevices(CL_DEVICE_TYPE_ALL, &devices);
+		for (size_t d = 0; d < devices.size(); d++)
+			std::cerr << "    device " << d << ": " << devices[d].getInfo<CL_DEVICE_NAME>() << std::endl;
+	}
+}
+
+// FNV-1a
+static uint64_t hashText(const std::string& text)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : text)
+	{
+		hash ^= c;
+		hash *= 1099511628211ULL;
 	}
+	return hash;
+}
+
+/**
+ * Binary cached for key, empty if there is none. The file starts with the whole key, so different keys with the same hash never match.
+ */
+static std::vector<char> loadBinary(const std::string& path, const std::string& key)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	std::string storedKey;
+	if (!file.is_open() || !std::getline(file, storedKey, '\0') || storedKey != key)
+		return std::vector<char>();
+	return std::vector<char>((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+}
+
+static void saveBinary(const std::string& path, const std::string& key, const cl::Program& program)
+{
+	std::vector<size_t> sizes = program.getInfo<CL_PROGRAM_BINARY_SIZES>();
+	if (sizes.size() != 1 || sizes[0] == 0)
+		return;
+	std::vector<char> binary(sizes[0]);
+	std::vector<char*> binaries{ binary.data() };
+	if (program.getInfo(CL_PROGRAM_BINARIES, &binaries) != CL_SUCCESS)
+		return;
+
+	// Written under another name first, so a concurrent run never reads half a file.
+	std::string temporary = path + ".tmp";
+	std::ofstream file(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(key.c_str(), key.size() + 1);
+	file.write(binary.data(), binary.size());
+	file.close();
+	if (!file || std::rename(temporary.c_str(), path.c_str()) != 0)
+		std::remove(temporary.c_str());
+}
+
+/**
+ * Pick the selected device, build the kernels for the active rule and create the queue (once per device and rule).
+ * The program binary is cached next to the kernel source, keyed by device, driver, build options and source.
+ */
+static void build()
+{
+	const Rule& rule = Rule::getActive();
+	std::string options = "-D BIRTH=" + std::to_string(rule.birth) + " -D SURVIVAL=" + std::to_string(rule.survival);
+	std::string selection = std::to_string(platformIndex) + ":" + std::to_string(deviceIndex) + " " + options;
+	if (selection == builtOptions)
+		return;
+	Timing::Scope buildTime("program build");
 
 	// Get all platforms (drivers), e.g. NVIDIA
 	std::vector<cl::Platform> all_platforms;
@@ -43,83 +147,285 @@ void GOLOpenCL::setup(bool** world, bool** newWorld, int width, int height)
 		std::cerr << " No platforms found. Check OpenCL installation!" << std::endl;
 		std::exit(1);
 	}
-	cl::Platform default_platform = all_platforms[0];
+	if (platformIndex >= all_platforms.size())
+	{
+		std::cerr << " No platform " << platformIndex << ", available are:" << std::endl;
+		listDevices(all_platforms);
+		std::exit(1);
+	}
+	cl::Platform platform = all_platforms[platformIndex];
 
-	// Get default device (CPUs, GPUs) of the default platform
+	// Get the devices (CPUs, GPUs) of the platform
 	std::vector<cl::Device> all_devices;
-	default_platform.getDevices(CL_DEVICE_TYPE_ALL, &all_devices);
+	platform.getDevices(CL_DEVICE_TYPE_ALL, &all_devices);
 	if (all_devices.size() == 0)
 	{
 		std::cerr << " No devices found. Check OpenCL installation!" << std::endl;
 		std::exit(1);
 	}
+	if (deviceIndex >= all_devices.size())
+	{
+		std::cerr << " No device " << deviceIndex << " on platform " << platformIndex << ", available are:" << std::endl;
+		listDevices(all_platforms);
+		std::exit(1);
+	}
 
-	// Use device[0] because that's the GPU
-	cl::Device default_device = all_devices[0];
+	// device[0] by default, usually the GPU
+	cl::Device selected_device = all_devices[deviceIndex];
 
 	// A context is like a "runtime link" to the device and platform;
 	// i.e. communication is possible
-	cl::Context context({ default_device });
-
-	// Create the program that we want to execute on the device
-	cl::Program::Sources sources;
+	context = cl::Context({ selected_device });
 
 	// Covert kernel to string
 	std::ifstream kernelFile("kernel/gol_kernel.cl");
 	std::string kernelCode((std::istreambuf_iterator<char>(kernelFile)), (std::istreambuf_iterator<char>()));
 
-	sources.push_back({ kernelCode.c_str(), kernelCode.length() });
+	// Anything that changes the binary is part of the key.
+	std::ostringstream key;
+	key << selected_device.getInfo<CL_DEVICE_NAME>() << "|" << selected_device.getInfo<CL_DEVICE_VENDOR>() << "|"
+		<< selected_device.getInfo<CL_DRIVER_VERSION>() << "|" << platform.getInfo<CL_PLATFORM_VERSION>() << "|"
+		<< options << "|" << std::hex << hashText(kernelCode);
+	std::ostringstream cachePath;
+	cachePath << "kernel/gol_kernel." << std::hex << std::setw(16) << std::setfill('0') << hashText(key.str()) << ".bin";
 
-	// Build kernel program
-	program = cl::Program(context, sources);
-	if (program.build({ default_device }) != CL_SUCCESS)
+	// Build kernel program from the cached binary if there is one, from source otherwise.
+	// The rule is a compile time constant of the kernels.
+	bool built = false;
+	std::vector<char> binary = loadBinary(cachePath.str(), key.str());
+	if (!binary.empty())
 	{
-		std::cerr << "Error building: " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(default_device) << std::endl;
-		exit(1);
+		cl::Program::Binaries binaries{ std::make_pair((const void*)binary.data(), binary.size()) };
+		cl_int status = CL_SUCCESS;
+		program = cl::Program(context, { selected_device }, binaries, nullptr, &status);
+		built = status == CL_SUCCESS && program.build({ selected_device }, options.c_str()) == CL_SUCCESS;
 	}
+	if (built)
+		cacheHits++;
+	else
+	{
+		cacheMisses++;
+		// Create the program that we want to execute on the device
+		cl::Program::Sources sources;
+		sources.push_back({ kernelCode.c_str(), kernelCode.length() });
+		program = cl::Program(context, sources);
+		if (program.build({ selected_device }, options.c_str()) != CL_SUCCESS)
+		{
+			std::cerr << "Error building: " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(selected_device) << std::endl;
+			exit(1);
+		}
+		saveBinary(cachePath.str(), key.str(), program);
+	}
+	Timing::getInstance()->setCounter("program cache hits", cacheHits);
+	Timing::getInstance()->setCounter("program cache misses", cacheMisses);
 
-	// Convert game dimensions to array
-	int dimensions[2]{ width, height };
-	worldSize = size;
-
-	// Allocate space on GPU
-	buffer_World = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(bool) * worldSize);
-	buffer_NewWorld = cl::Buffer(context, CL_MEM_WRITE_ONLY, sizeof(bool) * worldSize);
-	buffer_Dimensions = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(int) * 2);
+	// Kernels are created once; world and newWorld only swap arguments
+	kernel_WrapColumns = cl::Kernel(program, "wrap_columns");
+	kernel_WrapRows = cl::Kernel(program, "wrap_rows");
+	kernel_ProcessCell = cl::Kernel(program, "process_cell");
+	kernel_ProcessTile = cl::Kernel(program, "process_tile");
+	device = selected_device;
 
 	// Create a queue (a queue of commands that the GPU will execute)
-	queue = cl::CommandQueue(context, default_device);
+	queue = cl::CommandQueue(context, selected_device);
+	builtOptions = selection;
+	batchCapacity = 0;
+}
+
+void GOLOpenCL::setup(Grid* world, Grid* newWorld)
+{
+	// The grid is already contiguous, so it is uploaded as is (including halo and padding).
+	worldSize = world->getSize();
+	worldWidth = world->getWidth();
+	worldHeight = world->getHeight();
+	cellCount = (size_t)worldWidth * worldHeight;
+	build();
+
+	// Convert game dimensions to array
+	int dimensions[5]{ worldWidth, worldHeight, (int)world->getStride(), (int)world->getOffset(), (int)worldSize };
 
-	// Push write buffers to queue
-	queue.enqueueWriteBuffer(buffer_World, CL_TRUE, 0, sizeof(bool) * worldSize, world1D);
-	queue.enqueueWriteBuffer(buffer_NewWorld, CL_TRUE, 0, sizeof(bool) * worldSize, newWorld1D);
-	queue.enqueueWriteBuffer(buffer_Dimensions, CL_TRUE, 0, sizeof(int) * 2, dimensions);
+	// Both world buffers are read and written, they trade roles every generation.
+	// CPU devices work on the grids in host memory directly.
+	cl_device_type deviceType = device.getInfo<CL_DEVICE_TYPE>();
+	zeroCopy = (deviceType & CL_DEVICE_TYPE_CPU) != 0;
+	if (zeroCopy)
+	{
+		buffer_World = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(bool) * worldSize, world->getData());
+		buffer_NewWorld = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(bool) * worldSize, newWorld->getData());
+	}
+	else
+	{
+		buffer_World = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(bool) * worldSize);
+		buffer_NewWorld = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(bool) * worldSize);
+		queue.enqueueWriteBuffer(buffer_World, CL_TRUE, 0, sizeof(bool) * worldSize, world->getData());
+		queue.enqueueWriteBuffer(buffer_NewWorld, CL_TRUE, 0, sizeof(bool) * worldSize, newWorld->getData());
+	}
+	buffer_Dimensions = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * 5, dimensions);
+
+	buffer_Current = &buffer_World;
+	grid_World = world;
+	grid_NewWorld = newWorld;
 }
 
-bool** GOLOpenCL::runGenerations(bool** world, bool** newWorld, int width, int height, int generations)
+/**
+ * Wait for the queue and make the result buffer available in its grid.
+ */
+static Grid* readResult(cl::Buffer* current)
 {
-	for (unsigned int i = 0; i < generations; i++)
-	{	
-		// Send data and execute
-		cl::Kernel process_cell(program, "process_cell");
-		process_cell.setArg(0, buffer_World);
-		process_cell.setArg(1, buffer_NewWorld);
-		process_cell.setArg(2, buffer_Dimensions);
-		queue.enqueueNDRangeKernel(process_cell, cl::NullRange, cl::NDRange(worldSize));
+	buffer_Current = current;
+	Grid* result = current == &buffer_World ? grid_World : grid_NewWorld;
+	if (zeroCopy)
+	{
+		// Mapping makes sure the host memory is up to date
+		void* mapped = queue.enqueueMapBuffer(*current, CL_TRUE, CL_MAP_READ, 0, sizeof(bool) * worldSize);
+		queue.enqueueUnmapMemObject(*current, mapped);
 		queue.finish();
+	}
+	else
+	{
+		// Read result from GPU straight into the grid (blocking, waits for all generations)
+		queue.enqueueReadBuffer(*current, CL_TRUE, 0, sizeof(bool) * worldSize, result->getData());
+	}
+
+	return result;
+}
+
+Grid* GOLOpenCL::runGenerations(Grid* /* world */, Grid* /* newWorld */, int generations)
+{
+	cl::Buffer* current = buffer_Current;
+	cl::Buffer* next = current == &buffer_World ? &buffer_NewWorld : &buffer_World;
+	cl::Buffer* temp;
+
+	kernel_WrapColumns.setArg(1, buffer_Dimensions);
+	kernel_WrapRows.setArg(1, buffer_Dimensions);
+	kernel_ProcessCell.setArg(2, buffer_Dimensions);
+
+	// Queue every generation without waiting (the queue is in order)
+	for (int i = 0; i < generations; i++)
+	{
+		// Wrap around: columns first, then rows (including corners)
+		kernel_WrapColumns.setArg(0, *current);
+		queue.enqueueNDRangeKernel(kernel_WrapColumns, cl::NullRange, cl::NDRange(worldHeight));
+		kernel_WrapRows.setArg(0, *current);
+		queue.enqueueNDRangeKernel(kernel_WrapRows, cl::NullRange, cl::NDRange(worldWidth + 2));
+
+		kernel_ProcessCell.setArg(0, *current);
+		kernel_ProcessCell.setArg(1, *next);
+		queue.enqueueNDRangeKernel(kernel_ProcessCell, cl::NullRange, cl::NDRange(cellCount));
+
+		temp = current;
+		current = next;
+		next = temp;
+	}
+
+	return readResult(current);
+}
 
-		// Copy newWorld to world for repetition
-		queue.enqueueCopyBuffer(buffer_NewWorld, buffer_World, 0, 0, sizeof(bool) * worldSize);
+/**
+ * Advance depth generations per launch in local memory (see process_tile in the kernel).
+ */
+Grid* GOLOpenCL::runGenerationsTiled(Grid* /* world */, Grid* /* newWorld */, int generations, int groupWidth, int groupHeight, int depth)
+{
+	size_t maxGroupSize = kernel_ProcessTile.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+	if ((size_t)groupWidth * groupHeight > maxGroupSize)
+	{
+		std::cerr << "Work-group " << groupWidth << "x" << groupHeight << " too large, device allows " << maxGroupSize << " work-items." << std::endl;
+		std::exit(1);
 	}
-	// Read result from GPU to here
-	queue.enqueueReadBuffer(buffer_NewWorld, CL_TRUE, 0, sizeof(bool) * worldSize, newWorld1D);
-	// Convert to 2D array
-	for (unsigned int i = 0; i < worldSize; i++)
+	// Two tiles with a halo of depth cells per launch (the last launch may be shallower).
+	cl_ulong maxLocalSize = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+	int maxDepth = std::min(depth, generations);
+	size_t neededLocalSize = 2 * (size_t)(groupWidth + 2 * maxDepth) * (groupHeight + 2 * maxDepth);
+	if (neededLocalSize > maxLocalSize)
 	{
-		int x = i % width;
-		int y = i / width;
-		newWorld[y][x] = newWorld1D[i];
+		std::cerr << "Work-group " << groupWidth << "x" << groupHeight << " with depth " << maxDepth << " needs " << neededLocalSize
+			<< " bytes of local memory, device has " << maxLocalSize << "." << std::endl;
+		std::exit(1);
+	}
+
+	cl::Buffer* current = buffer_Current;
+	cl::Buffer* next = current == &buffer_World ? &buffer_NewWorld : &buffer_World;
+	cl::Buffer* temp;
+
+	// Round up to full work-groups
+	cl::NDRange global((worldWidth + groupWidth - 1) / groupWidth * groupWidth, (worldHeight + groupHeight - 1) / groupHeight * groupHeight);
+	cl::NDRange local(groupWidth, groupHeight);
+
+	kernel_ProcessTile.setArg(2, buffer_Dimensions);
+	for (int i = 0; i < generations; i += depth)
+	{
+		int launchDepth = std::min(depth, generations - i);
+		size_t localSize = (size_t)(groupWidth + 2 * launchDepth) * (groupHeight + 2 * launchDepth);
+
+		kernel_ProcessTile.setArg(0, *current);
+		kernel_ProcessTile.setArg(1, *next);
+		kernel_ProcessTile.setArg(3, launchDepth);
+		kernel_ProcessTile.setArg(4, cl::__local(localSize));
+		kernel_ProcessTile.setArg(5, cl::__local(localSize));
+		cl_int status = queue.enqueueNDRangeKernel(kernel_ProcessTile, cl::NullRange, global, local);
+		if (status != CL_SUCCESS)
+		{
+			std::cerr << "Launch of process_tile failed (error " << status << ")." << std::endl;
+			std::exit(1);
+		}
+
+		temp = current;
+		current = next;
+		next = temp;
+	}
+
+	return readResult(current);
+}
+
+/**
+ * Boards of the same size are copied into one buffer and computed together:
+ * the second work-item dimension is the board. Results are written back into worlds.
+ */
+void GOLOpenCL::runBatch(const std::vector<Grid*>& worlds, int generations)
+{
+	const Grid* first = worlds[0];
+	const size_t size = first->getSize();
+	const size_t count = worlds.size();
+	const int width = first->getWidth();
+	const int height = first->getHeight();
+	build();
+
+	if (batchCapacity < size * count)
+	{
+		batchCapacity = size * count;
+		buffer_BatchWorld = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(bool) * batchCapacity);
+		buffer_BatchNewWorld = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(bool) * batchCapacity);
+	}
+	int dimensions[5]{ width, height, (int)first->getStride(), (int)first->getOffset(), (int)size };
+	cl::Buffer batchDimensions(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * 5, dimensions);
+
+	// The queue is in order, so nothing needs to wait for the uploads
+	for (size_t i = 0; i < count; i++)
+		queue.enqueueWriteBuffer(buffer_BatchWorld, CL_FALSE, sizeof(bool) * size * i, sizeof(bool) * size, worlds[i]->getData());
+
+	cl::Buffer* current = &buffer_BatchWorld;
+	cl::Buffer* next = &buffer_BatchNewWorld;
+	cl::Buffer* temp;
+	kernel_WrapColumns.setArg(1, batchDimensions);
+	kernel_WrapRows.setArg(1, batchDimensions);
+	kernel_ProcessCell.setArg(2, batchDimensions);
+	for (int i = 0; i < generations; i++)
+	{
+		kernel_WrapColumns.setArg(0, *current);
+		queue.enqueueNDRangeKernel(kernel_WrapColumns, cl::NullRange, cl::NDRange(height, count));
+		kernel_WrapRows.setArg(0, *current);
+		queue.enqueueNDRangeKernel(kernel_WrapRows, cl::NullRange, cl::NDRange(width + 2, count));
+
+		kernel_ProcessCell.setArg(0, *current);
+		kernel_ProcessCell.setArg(1, *next);
+		queue.enqueueNDRangeKernel(kernel_ProcessCell, cl::NullRange, cl::NDRange((size_t)width * height, count));
+
+		temp = current;
+		current = next;
+		next = temp;
 	}
 
-	return newWorld;
+	for (size_t i = 0; i < count; i++)
+		queue.enqueueReadBuffer(*current, CL_FALSE, sizeof(bool) * size * i, sizeof(bool) * size, worlds[i]->getData());
+	queue.finish();
 }
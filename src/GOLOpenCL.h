@@ -1,10 +1,22 @@
 #pragma once
+#include "Grid.h"
+#include <vector>
 
 class GOLOpenCL
 {
 public:
-	static void setup(bool** world, bool** newWorld, int width, int height);
+	// Indices into the platforms and their devices (default 0 and 0), used from the next setup on.
+	static void selectDevice(unsigned int platform, unsigned int device);
+	// Whether the selected platform and device exist (setup exits otherwise).
+	static bool isAvailable();
+	static void setup(Grid* world, Grid* newWorld);
 
-	static bool** runGenerations(bool** world, bool** newWorld, int width, int height, int generations);
+	// Both continue from the last computed generation, the result is in world or newWorld given to setup.
+
+	static Grid* runGenerations(Grid* world, Grid* newWorld, int generations);
+	static Grid* runGenerationsTiled(Grid* world, Grid* newWorld, int generations, int groupWidth, int groupHeight, int depth);
+
+	// Boards of equal size in one launch per kernel and generation, needs no setup (the program is shared with it).
+	static void runBatch(const std::vector<Grid*>& worlds, int generations);
 };
 
@@ -1,8 +1,21 @@
 #include "GOLOpenMP.h"
+#include "ActiveTiles.h"
+#include "CycleDetector.h"
+#include "Rule.h"
+#include "../util/Timing.h"
 #include <omp.h>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <new>
 
-constexpr bool RULE_TABLE[2][9]{ {0,0,0,1,0,0,0,0,0},{0,0,1,1,0,0,0,0,0} };
+// Last generation finished by a band. One cache line each, so waiting threads don't slow down the owner.
+struct alignas(64) BandCounter
+{
+	std::atomic<int> generation;
+};
 
 void GOLOpenMP::setup(unsigned int numberOfThreads)
 {
@@ -15,75 +28,300 @@ void GOLOpenMP::setup(unsigned int numberOfThreads)
 		omp_set_dynamic(1);
 }
 
-bool** GOLOpenMP::runGenerations(bool** world, bool** newWorld, int width, int height, int generations)
+Grid* GOLOpenMP::runGenerations(Grid* world, Grid* newWorld, int generations)
+{
+	return withActiveRule([&](auto rule) { return runGenerations(world, newWorld, generations, rule); });
+}
+
+template<class CellRule>
+Grid* GOLOpenMP::runGenerations(Grid* world, Grid* newWorld, int generations, CellRule rule)
 {
-	bool** temp;
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	const bool detectCycles = CycleDetector::isEnabled();
+	CycleDetector cycles;
+	Grid* temp;
 	for (int i = 0; i < generations; i++)
 	{
+		Timing::Scope generation("generation", true);
+		uint64_t hash = 0;
+
+		// Wrap around once, then border and inside use the same path.
+		world->refreshHalo();
+
 		// Enter parallel section
 #pragma omp parallel
 		{
-			int neighborsAlive = 0;
 			// Share iterations. Allow continuation. 
-# pragma omp for nowait
-			for (int x = 0; x < width; x++)
+# pragma omp for nowait reduction(^ : hash)
+			for (int y = 0; y < height; y++)
 			{
-				neighborsAlive = getNeighborsAlive(world, x, 0, width, height);
-				newWorld[0][x] = RULE_TABLE[world[0][x]][neighborsAlive];
-				neighborsAlive = getNeighborsAlive(world, x, height - 1, width, height);
-				newWorld[height - 1][x] = RULE_TABLE[world[height - 1][x]][neighborsAlive];
+				const bool* above = world->getRow(y - 1);
+				const bool* row = world->getRow(y);
+				const bool* below = world->getRow(y + 1);
+				bool* newRow = newWorld->getRow(y);
+				for (int x = 0; x < width; x++)
+				{
+					int neighborsAlive = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+					newRow[x] = rule(row[x], neighborsAlive);
+				}
+				if (detectCycles)
+					hash ^= CycleDetector::hashRow(newRow, width, y);
 			}
-			// Share iterations. Allow continuation. 
-# pragma omp for nowait
-			for (int y = 1; y < height - 1; y++)
+		}
+		temp = world;
+		world = newWorld;
+		newWorld = temp;
+		if (detectCycles)
+			generations = (int)cycles.check(i + 1, hash, world, generations);
+	}
+	return world;
+}
+
+/**
+ * Temporal blocking: every tile is copied with a halo of tileDepth cells into a thread local buffer
+ * and advanced tileDepth generations there (the valid area shrinks by one cell per generation),
+ * so the board is only streamed through memory once every tileDepth generations.
+ */
+Grid* GOLOpenMP::runGenerationsTiled(Grid* world, Grid* newWorld, int generations, int tileSize, int tileDepth)
+{
+	return withActiveRule([&](auto rule) { return runGenerationsTiled(world, newWorld, generations, tileSize, tileDepth, rule); });
+}
+
+template<class CellRule>
+Grid* GOLOpenMP::runGenerationsTiled(Grid* world, Grid* newWorld, int generations, int tileSize, int tileDepth, CellRule rule)
+{
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	const int tilesX = (width + tileSize - 1) / tileSize;
+	const int tilesY = (height + tileSize - 1) / tileSize;
+	const int localSize = tileSize + 2 * tileDepth;
+	Grid* temp;
+	for (int i = 0; i < generations; i += tileDepth)
+	{
+		int depth = std::min(tileDepth, generations - i);
+
+		// Enter parallel section
+#pragma omp parallel
+		{
+			// Two local buffers per thread, kept for all tiles of this pass.
+			bool* current = new bool[localSize * localSize];
+			bool* next = new bool[localSize * localSize];
+
+			// Tiles at the border cost more (wrap around), so hand them out dynamically.
+# pragma omp for schedule(dynamic) nowait
+			for (int tile = 0; tile < tilesX * tilesY; tile++)
+				processTile(world, newWorld, (tile % tilesX) * tileSize, (tile / tilesX) * tileSize, tileSize, depth, current, next, rule);
+
+			delete[] current;
+			delete[] next;
+		}
+		temp = world;
+		world = newWorld;
+		newWorld = temp;
+	}
+	return world;
+}
+
+/**
+ * Advance the tile starting at (tileX, tileY) by depth generations and write it to newWorld.
+ */
+template<class CellRule>
+void GOLOpenMP::processTile(const Grid* world, Grid* newWorld, int tileX, int tileY, int tileSize, int depth, bool* current, bool* next, CellRule rule)
+{
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	const int tileWidth = std::min(tileSize, width - tileX);
+	const int tileHeight = std::min(tileSize, height - tileY);
+	const int localWidth = tileWidth + 2 * depth;
+	const int localHeight = tileHeight + 2 * depth;
+
+	// Load tile and halo (wrap around).
+	const int startX = tileX - depth;
+	const bool contiguous = startX >= 0 && startX + localWidth <= width;
+	for (int ly = 0; ly < localHeight; ly++)
+	{
+		int y = ((tileY - depth + ly) % height + height) % height;
+		const bool* row = world->getRow(y);
+		bool* localRow = current + ly * localWidth;
+		if (contiguous)
+			std::memcpy(localRow, row + startX, localWidth);
+		else
+		{
+			for (int lx = 0; lx < localWidth; lx++)
+				localRow[lx] = row[((startX + lx) % width + width) % width];
+		}
+	}
+
+	// Every generation the valid area shrinks by one cell on each side.
+	bool* temp;
+	for (int step = 1; step <= depth; step++)
+	{
+		for (int ly = step; ly < localHeight - step; ly++)
+		{
+			const bool* above = current + (ly - 1) * localWidth;
+			const bool* row = current + ly * localWidth;
+			const bool* below = current + (ly + 1) * localWidth;
+			bool* newRow = next + ly * localWidth;
+			for (int lx = step; lx < localWidth - step; lx++)
 			{
-				neighborsAlive = getNeighborsAlive(world, 0, y, width, height);
-				newWorld[y][0] = RULE_TABLE[world[y][0]][neighborsAlive];
-				neighborsAlive = getNeighborsAlive(world, width - 1, y, width, height);
-				newWorld[y][width - 1] = RULE_TABLE[world[y][width - 1]][neighborsAlive];
+				int neighborsAlive = above[lx - 1] + above[lx] + above[lx + 1] + row[lx - 1] + row[lx + 1] + below[lx - 1] + below[lx] + below[lx + 1];
+				newRow[lx] = rule(row[lx], neighborsAlive);
 			}
+		}
+		temp = current;
+		current = next;
+		next = temp;
+	}
 
-			// Share iterations. Allow continuation. 
-# pragma omp for nowait
-			for (int y = 1; y < height - 1; y++)
+	// Write back the tile.
+	for (int ty = 0; ty < tileHeight; ty++)
+		std::memcpy(newWorld->getRow(tileY + ty) + tileX, current + (ty + depth) * localWidth + depth, tileWidth);
+}
+
+/**
+ * One thread team for the whole run. Every thread owns a fixed band of rows and only waits
+ * for its two neighboring bands (wrap around) instead of a barrier over all threads:
+ * Before writing generation g + 1 a band needs generation g of its neighbors, which also
+ * means they are done reading the rows of generation g - 1 that are overwritten now.
+ */
+Grid* GOLOpenMP::runGenerationsPersistent(Grid* world, Grid* newWorld, int generations)
+{
+	return withActiveRule([&](auto rule) { return runGenerationsPersistent(world, newWorld, generations, rule); });
+}
+
+template<class CellRule>
+Grid* GOLOpenMP::runGenerationsPersistent(Grid* world, Grid* newWorld, int generations, CellRule rule)
+{
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	Grid* grids[2]{ world, newWorld };
+	const int maxBands = std::min(omp_get_max_threads(), height);
+	BandCounter* counters = (BandCounter*)alignedAlloc(alignof(BandCounter), sizeof(BandCounter) * maxBands);
+	for (int band = 0; band < maxBands; band++)
+	{
+		new (&counters[band]) BandCounter;
+		counters[band].generation.store(0);
+	}
+
+	// Wrap around once; afterwards each band keeps the halo of its own rows up to date.
+	world->refreshHalo();
+
+	// Enter parallel section (once)
+#pragma omp parallel
+	{
+		const int bands = std::min(omp_get_num_threads(), height);
+		const int band = omp_get_thread_num();
+		if (band < bands)
+		{
+			// Time of each thread including waits for its neighbors.
+			Timing::Scope busy("band");
+			const int startY = (int)((long long)height * band / bands);
+			const int endY = (int)((long long)height * (band + 1) / bands);
+			const BandCounter& previous = counters[(band + bands - 1) % bands];
+			const BandCounter& next = counters[(band + 1) % bands];
+
+			for (int i = 0; i < generations; i++)
 			{
-				for (int x = 1; x < width - 1; x++)
+				// Wait for neighbors to finish generation i.
+				while (previous.generation.load(std::memory_order_acquire) < i || next.generation.load(std::memory_order_acquire) < i)
+					std::this_thread::yield();
+
+				const Grid* current = grids[i % 2];
+				Grid* target = grids[(i + 1) % 2];
+				for (int y = startY; y < endY; y++)
 				{
-					neighborsAlive = world[y - 1][x - 1] + world[y - 1][x] + world[y - 1][x + 1] + world[y][x - 1] + world[y][x + 1] + world[y + 1][x - 1] + world[y + 1][x] + world[y + 1][x + 1];
-					newWorld[y][x] = RULE_TABLE[world[y][x]][neighborsAlive];
+					const bool* above = current->getRow(y - 1);
+					const bool* row = current->getRow(y);
+					const bool* below = current->getRow(y + 1);
+					bool* newRow = target->getRow(y);
+					for (int x = 0; x < width; x++)
+					{
+						int neighborsAlive = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+						newRow[x] = rule(row[x], neighborsAlive);
+					}
+					// Left and right halo
+					newRow[-1] = newRow[width - 1];
+					newRow[width] = newRow[0];
 				}
+				// Top and bottom halo (including corners) belong to the bands owning the last and first row.
+				if (startY == 0)
+					std::memcpy(target->getRow(height) - 1, target->getRow(0) - 1, width + 2);
+				if (endY == height)
+					std::memcpy(target->getRow(-1) - 1, target->getRow(height - 1) - 1, width + 2);
+
+				counters[band].generation.store(i + 1, std::memory_order_release);
 			}
 		}
-		temp = world;
-		world = newWorld;
-		newWorld = temp;
 	}
-	return world;
+
+	alignedFree(counters);
+	return grids[generations % 2];
 }
 
-int GOLOpenMP::getNeighborsAlive(bool** world, int x, int y, int width, int height)
+/**
+ * Only compute tiles that changed or have a changed neighbor in the last generation.
+ */
+Grid* GOLOpenMP::runGenerationsActive(Grid* world, Grid* newWorld, int generations, int tileSize)
 {
-	int alive = 0;
-# pragma omp parallel
+	return withActiveRule([&](auto rule) { return runGenerationsActive(world, newWorld, generations, tileSize, rule); });
+}
+
+template<class CellRule>
+Grid* GOLOpenMP::runGenerationsActive(Grid* world, Grid* newWorld, int generations, int tileSize, CellRule rule)
+{
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	ActiveTiles tiles(width, height, tileSize);
+	const int tileCount = tiles.getTileCount();
+	const int tilesX = tiles.getTilesX();
+	long long activeTiles = 0;
+	Grid* temp;
+	for (int i = 0; i < generations; i++)
 	{
-		# pragma omp for nowait
-		for (int yOffset = -1; yOffset <= 1; yOffset++)
+		world->refreshHalo();
+
+		// Enter parallel section. Active tiles are uneven, so hand them out dynamically.
+#pragma omp parallel for schedule(dynamic) reduction(+:activeTiles)
+		for (int tile = 0; tile < tileCount; tile++)
 		{
-			for (int xOffset = -1; xOffset <= 1; xOffset++)
+			int tileX = tile % tilesX;
+			int tileY = tile / tilesX;
+			if (!tiles.needsUpdate(tileX, tileY))
+				continue;
+			activeTiles++;
+
+			int startX = tileX * tileSize;
+			int startY = tileY * tileSize;
+			int endX = std::min(startX + tileSize, width);
+			int endY = std::min(startY + tileSize, height);
+			bool changed = false;
+			for (int y = startY; y < endY; y++)
 			{
-				// Skip self
-				if (yOffset == 0 && xOffset == 0)
-					continue;
-				// Wrap around.
-				int currentX = x + xOffset;
-				currentX = currentX == width ? 0 : currentX < 0 ? width - 1 : currentX;
-				int currentY = y + yOffset;
-				currentY = currentY == height ? 0 : currentY < 0 ? height - 1 : currentY;
-
-				if (world[currentY][currentX])
-					alive++;
+				const bool* above = world->getRow(y - 1);
+				const bool* row = world->getRow(y);
+				const bool* below = world->getRow(y + 1);
+				bool* newRow = newWorld->getRow(y);
+				for (int x = startX; x < endX; x++)
+				{
+					int neighborsAlive = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+					newRow[x] = rule(row[x], neighborsAlive);
+					changed |= newRow[x] != row[x];
+				}
 			}
+			tiles.setChanged(tileX, tileY, changed);
 		}
+		tiles.nextGeneration();
+
+		temp = world;
+		world = newWorld;
+		newWorld = temp;
 	}
-	return alive;
+
+	long long skippedTiles = (long long)tileCount * generations - activeTiles;
+	Timing* time = Timing::getInstance();
+	time->setCounter("active tiles", activeTiles);
+	time->setCounter("skipped tiles", skippedTiles);
+	time->setCounter("skipped tiles (%)", activeTiles + skippedTiles > 0 ? skippedTiles * 100 / (activeTiles + skippedTiles) : 0);
+	return world;
 }
@@ -1,10 +1,25 @@
 #pragma once
+#include "Grid.h"
 
 class GOLOpenMP
 {
 public:
 	static void setup(unsigned int numberOfThreads);
-	static bool** runGenerations(bool** world, bool** newWorld, int width, int height, int generations);
-	static int getNeighborsAlive(bool** world, int x, int y, int width, int height);
-};
+	static Grid* runGenerations(Grid* world, Grid* newWorld, int generations);
+	static Grid* runGenerationsTiled(Grid* world, Grid* newWorld, int generations, int tileSize, int tileDepth);
+	static Grid* runGenerationsPersistent(Grid* world, Grid* newWorld, int generations);
+	static Grid* runGenerationsActive(Grid* world, Grid* newWorld, int generations, int tileSize);
 
+private:
+	// CellRule: StaticRule or TableRule (Rule.h).
+	template<class CellRule>
+	static Grid* runGenerations(Grid* world, Grid* newWorld, int generations, CellRule rule);
+	template<class CellRule>
+	static Grid* runGenerationsTiled(Grid* world, Grid* newWorld, int generations, int tileSize, int tileDepth, CellRule rule);
+	template<class CellRule>
+	static Grid* runGenerationsPersistent(Grid* world, Grid* newWorld, int generations, CellRule rule);
+	template<class CellRule>
+	static Grid* runGenerationsActive(Grid* world, Grid* newWorld, int generations, int tileSize, CellRule rule);
+	template<class CellRule>
+	static void processTile(const Grid* world, Grid* newWorld, int tileX, int tileY, int tileSize, int depth, bool* current, bool* next, CellRule rule);
+};
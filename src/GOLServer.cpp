@@ -0,0 +1,359 @@
+#include "GOLServer.h"
+#include "GOLFile.h"
+#include "GOLSingleThread.h"
+#include <iostream>
+
+#ifdef _WIN32
+
+int GOLServer::run(const std::string& path, unsigned int activeTileSize)
+{
+	std::cerr << "--serve needs Unix domain sockets and is not supported on Windows." << std::endl;
+	return 1;
+}
+
+void GOLServer::serveClient(int client)
+{
+}
+
+#else
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <vector>
+#include <new>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Resident board: the two grids are allocated once and trade roles, generation counts from upload (or open).
+ */
+struct Board
+{
+	std::mutex mutex;
+	std::unique_ptr<Grid> world;
+	std::unique_ptr<Grid> newWorld;
+	unsigned long long generation = 0;
+
+	Board(unsigned int width, unsigned int height) : world(new Grid(width, height)), newWorld(new Grid(width, height)) {}
+};
+
+/**
+ * Client socket with buffered line reads.
+ */
+class Connection
+{
+public:
+	explicit Connection(int socket) : mSocket(socket) {}
+	~Connection() { ::close(mSocket); }
+
+	// Without the line break (and a trailing '\r'), false at the end of the stream.
+	bool readLine(std::string& line)
+	{
+		size_t end;
+		while ((end = mBuffer.find('\n', mStart)) == std::string::npos)
+		{
+			mBuffer.erase(0, mStart);
+			mStart = 0;
+			char chunk[65536];
+			ssize_t received = ::read(mSocket, chunk, sizeof(chunk));
+			if (received <= 0)
+				return false;
+			mBuffer.append(chunk, received);
+		}
+		line.assign(mBuffer, mStart, end - mStart);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		mStart = end + 1;
+		return true;
+	}
+
+	bool write(const std::string& text)
+	{
+		size_t written = 0;
+		while (written < text.size())
+		{
+			ssize_t count = ::write(mSocket, text.data() + written, text.size() - written);
+			if (count <= 0)
+				return false;
+			written += count;
+		}
+		return true;
+	}
+
+private:
+	int mSocket;
+	std::string mBuffer;
+	size_t mStart = 0;
+};
+
+// Largest board of upload and open (both grids together take twice as many bytes).
+static const unsigned long long MAX_BOARD_CELLS = 1ULL << 32;
+
+static std::map<std::string, std::shared_ptr<Board>> boards;
+static std::mutex boardsMutex;
+static unsigned int tileSize = 0;
+
+static std::shared_ptr<Board> findBoard(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(boardsMutex);
+	auto board = boards.find(name);
+	return board == boards.end() ? nullptr : board->second;
+}
+
+static void storeBoard(const std::string& name, const std::shared_ptr<Board>& board)
+{
+	std::lock_guard<std::mutex> lock(boardsMutex);
+	boards[name] = board;
+}
+
+/**
+ * Board of width * height cells; nullptr and an error reply if it is too large or there is not enough memory.
+ */
+static std::shared_ptr<Board> createBoard(unsigned long long width, unsigned long long height, std::string& reply)
+{
+	std::string size = std::to_string(width) + "x" + std::to_string(height);
+	if (width * height > MAX_BOARD_CELLS)
+	{
+		reply = "error " + size + " is larger than " + std::to_string(MAX_BOARD_CELLS) + " cells\n";
+		return nullptr;
+	}
+	try
+	{
+		return std::make_shared<Board>((unsigned int)width, (unsigned int)height);
+	}
+	catch (const std::bad_alloc&)
+	{
+		reply = "error not enough memory for " + size + "\n";
+		return nullptr;
+	}
+}
+
+/**
+ * "ok", then width * height cells from (startX, startY) on, wrapping around, in the .gol text format.
+ */
+static std::string formatArea(const Grid* world, long long startX, long long startY, unsigned int width, unsigned int height)
+{
+	const long long worldWidth = world->getWidth();
+	const long long worldHeight = world->getHeight();
+	std::string text = "ok\n" + std::to_string(width) + "," + std::to_string(height) + "\n";
+	text.reserve(text.size() + (size_t)(width + 1) * height);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const bool* row = world->getRow((int)(((startY + y) % worldHeight + worldHeight) % worldHeight));
+		for (unsigned int x = 0; x < width; x++)
+			text += row[((startX + x) % worldWidth + worldWidth) % worldWidth] ? GOLFile::ALIVE : GOLFile::DEAD;
+		text += '\n';
+	}
+	return text;
+}
+
+int GOLServer::run(const std::string& path, unsigned int activeTileSize)
+{
+	tileSize = activeTileSize;
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		std::cerr << "Socket path " << path << " is too long." << std::endl;
+		return 1;
+	}
+	std::strcpy(address.sun_path, path.c_str());
+
+	// Clients that disconnect while being answered must not end the server.
+	std::signal(SIGPIPE, SIG_IGN);
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	// A socket file left by an earlier server would make bind fail.
+	unlink(path.c_str());
+	if (server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) != 0 || listen(server, 64) != 0)
+	{
+		std::cerr << "COULD NOT LISTEN ON " << path << ": " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	std::cerr << "Serving on " << path << std::endl;
+
+	while (true)
+	{
+		int client = accept(server, nullptr, nullptr);
+		if (client >= 0)
+			std::thread(serveClient, client).detach();
+	}
+}
+
+/**
+ * Answer one command (without quit); false if the client disconnected in the middle of it.
+ */
+static bool handleCommand(Connection& connection, const std::string& command, std::istringstream& arguments, std::string& reply)
+{
+	std::string name;
+	if (command == "list")
+	{
+		// Boards being advanced are waited for without blocking the other clients.
+		std::vector<std::pair<std::string, std::shared_ptr<Board>>> entries;
+		{
+			std::lock_guard<std::mutex> lock(boardsMutex);
+			entries.assign(boards.begin(), boards.end());
+		}
+		reply = "ok " + std::to_string(entries.size()) + "\n";
+		for (const auto& entry : entries)
+		{
+			std::lock_guard<std::mutex> boardLock(entry.second->mutex);
+			const Grid* world = entry.second->world.get();
+			reply += entry.first + " " + std::to_string(world->getWidth()) + "," + std::to_string(world->getHeight()) + " " + std::to_string(entry.second->generation) + "\n";
+		}
+	}
+	else if (!(arguments >> name))
+		reply = "error " + command + " needs a board name\n";
+	else if (command == "upload")
+	{
+		long long width = 0, height = 0;
+		if (!(arguments >> width >> height) || width <= 0 || height <= 0 || width > INT_MAX || height > INT_MAX)
+			reply = "error upload needs <name> <width> <height>\n";
+		else
+		{
+			// All rows are read, even after an error, so the next command starts at a line of its own.
+			std::shared_ptr<Board> board = createBoard(width, height, reply);
+			std::string row;
+			long long y = 0;
+			for (; y < height && reply.empty(); y++)
+			{
+				if (!connection.readLine(row))
+					return false;
+				if ((long long)row.size() != width || row.find_first_not_of(std::string{ GOLFile::ALIVE, GOLFile::DEAD }) != std::string::npos)
+				{
+					reply = "error row " + std::to_string(y) + " must have " + std::to_string(width) + " cells of '" + GOLFile::ALIVE + "' and '" + GOLFile::DEAD + "'\n";
+					continue;
+				}
+				bool* cells = board->world->getRow((int)y);
+				for (long long x = 0; x < width; x++)
+					cells[x] = row[x] == GOLFile::ALIVE;
+			}
+			for (; y < height; y++)
+			{
+				if (!connection.readLine(row))
+					return false;
+			}
+			if (reply.empty())
+			{
+				storeBoard(name, board);
+				reply = "ok\n";
+			}
+		}
+	}
+	else if (command == "open")
+	{
+		std::string path;
+		GOLFile input;
+		if (!(arguments >> path))
+			reply = "error open needs <name> <path>\n";
+		else if (!input.open(path))
+			reply = "error " + input.getError() + "\n";
+		else
+		{
+			std::shared_ptr<Board> board = createBoard(input.getWidth(), input.getHeight(), reply);
+			if (board && !input.readInto(board->world.get()))
+				reply = "error " + input.getError() + "\n";
+			else if (board)
+			{
+				storeBoard(name, board);
+				reply = "ok\n";
+			}
+		}
+	}
+	else if (command == "drop")
+	{
+		std::lock_guard<std::mutex> lock(boardsMutex);
+		reply = boards.erase(name) > 0 ? "ok\n" : "error no board " + name + "\n";
+	}
+	else
+	{
+		std::shared_ptr<Board> board = findBoard(name);
+		if (!board)
+			reply = "error no board " + name + "\n";
+		else
+		{
+			std::lock_guard<std::mutex> lock(board->mutex);
+			const Grid* world = board->world.get();
+			long long generations, x, y, width, height;
+			std::string path;
+			if (command == "advance")
+			{
+				if (!(arguments >> generations) || generations < 0 || generations > UINT_MAX)
+					reply = "error advance needs <name> <generations>\n";
+				else
+				{
+					Grid* result = tileSize > 0
+						? GOLSingleThread::runGenerationsActive(board->world.get(), board->newWorld.get(), (unsigned int)generations, tileSize)
+						: GOLSingleThread::runGenerations(board->world.get(), board->newWorld.get(), (unsigned int)generations);
+					if (result != board->world.get())
+						std::swap(board->world, board->newWorld);
+					board->generation += generations;
+					reply = "ok " + std::to_string(board->generation) + "\n";
+				}
+			}
+			else if (command == "query")
+			{
+				if (!(arguments >> x >> y >> width >> height) || width <= 0 || height <= 0 || width > world->getWidth() || height > world->getHeight())
+					reply = "error query needs <name> <x> <y> <width> <height>, at most the size of the board\n";
+				else
+					reply = formatArea(world, x, y, (unsigned int)width, (unsigned int)height);
+			}
+			else if (command == "dump")
+				reply = formatArea(world, 0, 0, world->getWidth(), world->getHeight());
+			else if (command == "save")
+			{
+				if (!(arguments >> path))
+					reply = "error save needs <name> <path>\n";
+				else
+					reply = GOLFile::save(path, world) ? "ok\n" : "error could not write " + path + "\n";
+			}
+			else
+				reply = "error unknown command " + command + "\n";
+		}
+	}
+	return true;
+}
+
+/**
+ * Answer the commands of one client until it quits or disconnects.
+ */
+void GOLServer::serveClient(int client)
+{
+	Connection connection(client);
+	std::string line;
+	while (connection.readLine(line))
+	{
+		std::istringstream arguments(line);
+		std::string command;
+		arguments >> command;
+		if (command.empty())
+			continue;
+		if (command == "quit")
+			break;
+
+		// An exception must not leave the thread: std::terminate would end the server with all boards.
+		std::string reply;
+		try
+		{
+			if (!handleCommand(connection, command, arguments, reply))
+				break;
+		}
+		catch (const std::exception& error)
+		{
+			reply = std::string("error ") + error.what() + "\n";
+		}
+
+		if (!connection.write(reply))
+			break;
+	}
+}
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+
+/**
+ * Resident boards behind a Unix domain socket (--serve). Boards are kept in memory by name, so they are
+ * parsed and allocated once and then only advanced. Every client has its own thread, different boards
+ * are computed concurrently (one command at a time per board, with the sequential engine).
+ *
+ * One command per line, answered with "ok ..." or "error <message>":
+ *   upload <name> <width> <height>          followed by height rows of 'x' and '.' (as in .gol files)
+ *   open <name> <path>                      board file on the server, any format of --load
+ *   advance <name> <generations>            -> ok <generations advanced since upload or open>
+ *   query <name> <x> <y> <width> <height>   -> ok, then the area (wrapping around) in the .gol text format
+ *   dump <name>                             -> ok, then the whole board in the .gol text format
+ *   save <name> <path>                      board file on the server, format from the extension
+ *   drop <name>
+ *   list                                    -> ok <count>, then "<name> <width>,<height> <generation>" per board
+ *   quit
+ */
+class GOLServer
+{
+public:
+	// Serves until the process is stopped; returns 1 if the socket cannot be set up.
+	static int run(const std::string& path, unsigned int activeTileSize);
+
+private:
+	static void serveClient(int client);
+};
@@ -0,0 +1,189 @@
+#include "GOLSimd.h"
+#include "../util/Timing.h"
+#include "CycleDetector.h"
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC allows every intrinsic in every function.
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
+static InstructionSet instructionSet;
+
+/**
+ * A cell lives in the next generation if (neighbors | self) == 3,
+ * which is the same as RULE_TABLE: 3 neighbors, or 2 neighbors and alive.
+ */
+static inline uint8_t applyRule(const uint8_t* above, const uint8_t* row, const uint8_t* below, unsigned int x)
+{
+	uint8_t neighborsAlive = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+	return (neighborsAlive | row[x]) == 3;
+}
+
+void GOLSimd::setup()
+{
+	instructionSet = detectInstructionSet();
+}
+
+Grid* GOLSimd::runGenerations(Grid* world, Grid* newWorld, unsigned int generations)
+{
+	const unsigned int width = world->getWidth();
+	const int height = world->getHeight();
+	const bool detectCycles = CycleDetector::isEnabled();
+	CycleDetector cycles;
+	Grid* temp;
+	for (unsigned int i = 0; i < generations; i++)
+	{
+		Timing::Scope generation("generation", true);
+		uint64_t hash = 0;
+
+		// The halo makes every cell use the same branch-free path.
+		world->refreshHalo();
+
+		for (int y = 0; y < height; y++)
+		{
+			// Cells are bools (one byte, 0 or 1). Shift by one so the halo is at index 0.
+			const uint8_t* above = reinterpret_cast<const uint8_t*>(world->getRow(y - 1) - 1);
+			const uint8_t* row = reinterpret_cast<const uint8_t*>(world->getRow(y) - 1);
+			const uint8_t* below = reinterpret_cast<const uint8_t*>(world->getRow(y + 1) - 1);
+			uint8_t* newRow = reinterpret_cast<uint8_t*>(newWorld->getRow(y) - 1);
+
+			// Vectorized part returns the first column it didn't process.
+			unsigned int x = 1;
+			switch (instructionSet)
+			{
+			case InstructionSet::AVX512:
+				x = processRowAVX512(above, row, below, newRow, width);
+				break;
+			case InstructionSet::AVX2:
+				x = processRowAVX2(above, row, below, newRow, width);
+				break;
+			case InstructionSet::SSE2:
+				x = processRowSSE2(above, row, below, newRow, width);
+				break;
+			default:
+				break;
+			}
+
+			// Remaining cells.
+			for (; x <= width; x++)
+				newRow[x] = applyRule(above, row, below, x);
+			if (detectCycles)
+				hash ^= CycleDetector::hashRow(newRow + 1, width, y);
+		}
+		temp = world;
+		world = newWorld;
+		newWorld = temp;
+		if (detectCycles)
+			generations = cycles.check(i + 1, hash, world, generations);
+	}
+	return world;
+}
+
+unsigned int GOLSimd::processRowSSE2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* newRow, unsigned int width)
+{
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i three = _mm_set1_epi8(3);
+	unsigned int x = 1;
+	for (; x + 16 <= width + 1; x += 16)
+	{
+		__m128i self = _mm_loadu_si128((const __m128i*)(row + x));
+		__m128i neighborsAlive = _mm_add_epi8(
+			_mm_add_epi8(
+				_mm_add_epi8(_mm_loadu_si128((const __m128i*)(above + x - 1)), _mm_loadu_si128((const __m128i*)(above + x))),
+				_mm_add_epi8(_mm_loadu_si128((const __m128i*)(above + x + 1)), _mm_loadu_si128((const __m128i*)(row + x - 1)))),
+			_mm_add_epi8(
+				_mm_add_epi8(_mm_loadu_si128((const __m128i*)(row + x + 1)), _mm_loadu_si128((const __m128i*)(below + x - 1))),
+				_mm_add_epi8(_mm_loadu_si128((const __m128i*)(below + x)), _mm_loadu_si128((const __m128i*)(below + x + 1)))));
+		__m128i alive = _mm_cmpeq_epi8(_mm_or_si128(neighborsAlive, self), three);
+		_mm_storeu_si128((__m128i*)(newRow + x), _mm_and_si128(alive, one));
+	}
+	return x;
+}
+
+TARGET_AVX2
+unsigned int GOLSimd::processRowAVX2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* newRow, unsigned int width)
+{
+	const __m256i one = _mm256_set1_epi8(1);
+	const __m256i three = _mm256_set1_epi8(3);
+	unsigned int x = 1;
+	for (; x + 32 <= width + 1; x += 32)
+	{
+		__m256i self = _mm256_loadu_si256((const __m256i*)(row + x));
+		__m256i neighborsAlive = _mm256_add_epi8(
+			_mm256_add_epi8(
+				_mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(above + x - 1)), _mm256_loadu_si256((const __m256i*)(above + x))),
+				_mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(above + x + 1)), _mm256_loadu_si256((const __m256i*)(row + x - 1)))),
+			_mm256_add_epi8(
+				_mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(row + x + 1)), _mm256_loadu_si256((const __m256i*)(below + x - 1))),
+				_mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(below + x)), _mm256_loadu_si256((const __m256i*)(below + x + 1)))));
+		__m256i alive = _mm256_cmpeq_epi8(_mm256_or_si256(neighborsAlive, self), three);
+		_mm256_storeu_si256((__m256i*)(newRow + x), _mm256_and_si256(alive, one));
+	}
+	return x;
+}
+
+TARGET_AVX512
+unsigned int GOLSimd::processRowAVX512(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* newRow, unsigned int width)
+{
+	const __m512i one = _mm512_set1_epi8(1);
+	const __m512i three = _mm512_set1_epi8(3);
+	unsigned int x = 1;
+	for (; x + 64 <= width + 1; x += 64)
+	{
+		__m512i self = _mm512_loadu_si512(row + x);
+		__m512i neighborsAlive = _mm512_add_epi8(
+			_mm512_add_epi8(
+				_mm512_add_epi8(_mm512_loadu_si512(above + x - 1), _mm512_loadu_si512(above + x)),
+				_mm512_add_epi8(_mm512_loadu_si512(above + x + 1), _mm512_loadu_si512(row + x - 1))),
+			_mm512_add_epi8(
+				_mm512_add_epi8(_mm512_loadu_si512(row + x + 1), _mm512_loadu_si512(below + x - 1)),
+				_mm512_add_epi8(_mm512_loadu_si512(below + x), _mm512_loadu_si512(below + x + 1))));
+		__mmask64 alive = _mm512_cmpeq_epi8_mask(_mm512_or_si512(neighborsAlive, self), three);
+		_mm512_storeu_si512(newRow + x, _mm512_maskz_mov_epi8(alive, one));
+	}
+	return x;
+}
+
+/**
+ * Get the widest instruction set supported by the CPU (and OS) running this binary.
+ */
+InstructionSet GOLSimd::detectInstructionSet()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	bool avx2 = false;
+	bool avx512 = false;
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		// YMM state enabled by the OS
+		avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+		// ZMM state enabled by the OS; AVX-512F and AVX-512BW
+		avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 && (xcr0 & 0xE6) == 0xE6;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2");
+	bool avx2 = __builtin_cpu_supports("avx2");
+	bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+	if (avx512)
+		return InstructionSet::AVX512;
+	if (avx2)
+		return InstructionSet::AVX2;
+	if (sse2)
+		return InstructionSet::SSE2;
+	return InstructionSet::SCALAR;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include "Grid.h"
+
+enum class InstructionSet
+{
+	SCALAR, SSE2, AVX2, AVX512
+};
+
+class GOLSimd
+{
+public:
+	static void setup();
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations);
+	static InstructionSet detectInstructionSet();
+
+private:
+	static unsigned int processRowSSE2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* newRow, unsigned int width);
+	static unsigned int processRowAVX2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* newRow, unsigned int width);
+	static unsigned int processRowAVX512(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* newRow, unsigned int width);
+};
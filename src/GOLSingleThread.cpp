@@ -1,78 +1,135 @@
 #include "GOLSingleThread.h"
+#include "ActiveTiles.h"
+#include "CycleDetector.h"
+#include "Rule.h"
+#include "../util/Timing.h"
+#include <algorithm>
 
 
-constexpr bool RULE_TABLE[2][9]{ {0,0,0,1,0,0,0,0,0},{0,0,1,1,0,0,0,0,0} };
+Grid* GOLSingleThread::runGenerations(Grid* world, Grid* newWorld, unsigned int generations)
+{
+	return withActiveRule([&](auto rule) { return runGenerations(world, newWorld, generations, rule); });
+}
 
-bool** GOLSingleThread::runGenerations(bool** world, bool** newWorld, unsigned int width, unsigned int height, unsigned int generations)
+template<class CellRule>
+Grid* GOLSingleThread::runGenerations(Grid* world, Grid* newWorld, unsigned int generations, CellRule rule)
 {
-	bool** temp;
-	// Calculate inner field
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	const bool detectCycles = CycleDetector::isEnabled();
+	CycleDetector cycles;
+	Grid* temp;
 	for (unsigned int i = 0; i < generations; i++)
 	{
-		// Calculate border
-		// Top and bottom
-		int neighborsAlive = 0;
-		for (unsigned int x = 0; x < width; x++)
-		{
-			neighborsAlive = getNeighborsAlive(world, x, 0, width, height);
-			newWorld[0][x] = RULE_TABLE[world[0][x]][neighborsAlive];
-			neighborsAlive = getNeighborsAlive(world, x, height - 1, width, height);
-			newWorld[height - 1][x] = RULE_TABLE[world[height - 1][x]][neighborsAlive];
-		}
-		// Left and right
-		for (unsigned int y = 1; y < height - 1; y++)
-		{
-			neighborsAlive = getNeighborsAlive(world, 0, y, width, height);
-			newWorld[y][0] = RULE_TABLE[world[y][0]][neighborsAlive];
-			neighborsAlive = getNeighborsAlive(world, width - 1, y, width, height);
-			newWorld[y][width - 1] = RULE_TABLE[world[y][width - 1]][neighborsAlive];
-		}
+		Timing::Scope generation("generation", true);
+		uint64_t hash = 0;
+
+		// Wrap around once, then border and inside use the same path.
+		world->refreshHalo();
 
-		// Calculate inside
-		for (unsigned int y = 1; y < height - 1; y++)
+		for (int y = 0; y < height; y++)
 		{
-			for (unsigned int x = 1; x < width - 1; x++)
+			const bool* above = world->getRow(y - 1);
+			const bool* row = world->getRow(y);
+			const bool* below = world->getRow(y + 1);
+			bool* newRow = newWorld->getRow(y);
+			for (int x = 0; x < width; x++)
 			{
 				// Check neighnors.
-				neighborsAlive =
-					world[y - 1][x - 1] +	// Top left
-					world[y - 1][x] +		// Top middle 
-					world[y - 1][x + 1] +	// Top right
-					world[y][x - 1] +		// Left
-					world[y][x + 1] +		// Right
-					world[y + 1][x - 1] +	// Bottom left
-					world[y + 1][x] +		// Bottom middle
-					world[y + 1][x + 1];	// Bottom right
+				int neighborsAlive =
+					above[x - 1] +	// Top left
+					above[x] +		// Top middle 
+					above[x + 1] +	// Top right
+					row[x - 1] +	// Left
+					row[x + 1] +	// Right
+					below[x - 1] +	// Bottom left
+					below[x] +		// Bottom middle
+					below[x + 1];	// Bottom right
 
-				newWorld[y][x] = RULE_TABLE[world[y][x]][neighborsAlive];
+				newRow[x] = rule(row[x], neighborsAlive);
 			}
+			if (detectCycles)
+				hash ^= CycleDetector::hashRow(newRow, width, y);
 		}
 		temp = world;
 		world = newWorld;
 		newWorld = temp;
+		if (detectCycles)
+			generations = cycles.check(i + 1, hash, world, generations);
 	}
 	return world;
 }
 
-int GOLSingleThread::getNeighborsAlive(bool** world, int x, int y, unsigned int width, unsigned int height)
+/**
+ * Only compute tiles that changed or have a changed neighbor in the last generation.
+ */
+Grid* GOLSingleThread::runGenerationsActive(Grid* world, Grid* newWorld, unsigned int generations, unsigned int tileSize)
 {
-	unsigned int alive = 0;
-	for (int yOffset = -1; yOffset <= 1; yOffset++)
+	return withActiveRule([&](auto rule) { return runGenerationsActive(world, newWorld, generations, tileSize, rule); });
+}
+
+template<class CellRule>
+Grid* GOLSingleThread::runGenerationsActive(Grid* world, Grid* newWorld, unsigned int generations, unsigned int tileSize, CellRule rule)
+{
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	ActiveTiles tiles(width, height, tileSize);
+	long long activeTiles = 0;
+	long long skippedTiles = 0;
+	Grid* temp;
+	for (unsigned int i = 0; i < generations; i++)
 	{
-		for (int xOffset = -1; xOffset <= 1; xOffset++)
+		world->refreshHalo();
+
+		for (int tileY = 0; tileY < tiles.getTilesY(); tileY++)
 		{
-			// Skip self
-			if (yOffset == 0 && xOffset == 0)
-				continue;
-			// Wrap around.
-			int currentX = x + xOffset;
-			currentX = currentX == width ? 0 : currentX < 0 ? width - 1 : currentX;
-			int currentY = y + yOffset;
-			currentY = currentY == height ? 0 : currentY < 0 ? height - 1 : currentY;
+			for (int tileX = 0; tileX < tiles.getTilesX(); tileX++)
+			{
+				if (!tiles.needsUpdate(tileX, tileY))
+				{
+					skippedTiles++;
+					continue;
+				}
+				activeTiles++;
+				int startX = tileX * tileSize;
+				int startY = tileY * tileSize;
+				bool changed = processTile(world, newWorld, startX, startY, std::min(startX + (int)tileSize, width), std::min(startY + (int)tileSize, height), rule);
+				tiles.setChanged(tileX, tileY, changed);
+			}
+		}
+		tiles.nextGeneration();
+
+		temp = world;
+		world = newWorld;
+		newWorld = temp;
+	}
 
-			if (world[currentY][currentX])
-				alive++;
+	Timing* time = Timing::getInstance();
+	time->setCounter("active tiles", activeTiles);
+	time->setCounter("skipped tiles", skippedTiles);
+	time->setCounter("skipped tiles (%)", activeTiles + skippedTiles > 0 ? skippedTiles * 100 / (activeTiles + skippedTiles) : 0);
+	return world;
+}
+
+/**
+ * Compute cells [startX, endX) x [startY, endY). Returns whether any of them changed.
+ */
+template<class CellRule>
+bool GOLSingleThread::processTile(const Grid* world, Grid* newWorld, int startX, int startY, int endX, int endY, CellRule rule)
+{
+	bool changed = false;
+	for (int y = startY; y < endY; y++)
+	{
+		const bool* above = world->getRow(y - 1);
+		const bool* row = world->getRow(y);
+		const bool* below = world->getRow(y + 1);
+		bool* newRow = newWorld->getRow(y);
+		for (int x = startX; x < endX; x++)
+		{
+			int neighborsAlive = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+			newRow[x] = rule(row[x], neighborsAlive);
+			changed |= newRow[x] != row[x];
 		}
 	}
-	return alive;
+	return changed;
 }
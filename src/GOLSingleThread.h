@@ -1,9 +1,18 @@
 #pragma once
+#include "Grid.h"
 
 class GOLSingleThread
 {
 public:
-	static bool** runGenerations(bool** world, bool** newWorld, unsigned int width, unsigned int height, unsigned int generations);
-	static int getNeighborsAlive(bool** world, int x, int y, unsigned int width, unsigned int height);
-};
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations);
+	static Grid* runGenerationsActive(Grid* world, Grid* newWorld, unsigned int generations, unsigned int tileSize);
 
+private:
+	// CellRule: StaticRule or TableRule (Rule.h).
+	template<class CellRule>
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations, CellRule rule);
+	template<class CellRule>
+	static Grid* runGenerationsActive(Grid* world, Grid* newWorld, unsigned int generations, unsigned int tileSize, CellRule rule);
+	template<class CellRule>
+	static bool processTile(const Grid* world, Grid* newWorld, int startX, int startY, int endX, int endY, CellRule rule);
+};
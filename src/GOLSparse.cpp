@@ -0,0 +1,234 @@
+#include "GOLSparse.h"
+#include "GOLBitPacked.h"
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+static std::unordered_map<uint64_t, SparseChunk*> chunks;
+// Released chunks, reused before allocating new ones.
+static std::vector<SparseChunk*> pool;
+
+static bool hasWindow;
+static int64_t windowX;
+static int64_t windowY;
+static unsigned int windowWidth;
+static unsigned int windowHeight;
+
+// Offsets of SparseChunk::neighbors.
+static const int NEIGHBOR_X[8]{ -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int NEIGHBOR_Y[8]{ -1, -1, -1, 0, 0, 1, 1, 1 };
+
+static inline uint64_t chunkKey(int64_t x, int64_t y)
+{
+	return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+}
+
+void GOLSparse::setup(const Grid* world)
+{
+	// Start from an empty plane (setup may be called again for another board).
+	for (auto& entry : chunks)
+		releaseChunk(entry.second);
+	chunks.clear();
+
+	const int64_t width = world->getWidth();
+	const int64_t height = world->getHeight();
+	for (int64_t y = 0; y < height; y++)
+	{
+		const bool* row = world->getRow((int)y);
+		for (int64_t x = 0; x < width; x++)
+		{
+			if (row[x])
+				getChunk(x / 64, y / 64, true)->cells[y % 64] |= 1ULL << (x % 64);
+		}
+	}
+}
+
+void GOLSparse::setWindow(int64_t x, int64_t y, unsigned int width, unsigned int height)
+{
+	hasWindow = width > 0 && height > 0;
+	windowX = x;
+	windowY = y;
+	windowWidth = width;
+	windowHeight = height;
+}
+
+Grid* GOLSparse::runGenerations(Grid* /* world */, Grid* /* newWorld */, unsigned int generations)
+{
+	std::vector<SparseChunk*> active;
+	for (unsigned int i = 0; i < generations; i++)
+	{
+		// Alive cells on an edge can give birth in the neighboring chunk, make sure it exists.
+		active.clear();
+		for (auto& entry : chunks)
+			active.push_back(entry.second);
+		for (SparseChunk* chunk : active)
+		{
+			uint64_t left = 0, right = 0;
+			for (int r = 0; r < 64; r++)
+			{
+				left |= chunk->cells[r] & 1;
+				right |= chunk->cells[r] >> 63;
+			}
+			bool top = chunk->cells[0] != 0;
+			bool bottom = chunk->cells[63] != 0;
+			bool edge[8]{ top && left, top, top && right, left != 0, right != 0, bottom && left, bottom, bottom && right };
+			for (int n = 0; n < 8; n++)
+			{
+				if (edge[n])
+					getChunk(chunk->x + NEIGHBOR_X[n], chunk->y + NEIGHBOR_Y[n], true);
+			}
+		}
+
+		// Link neighbors (nullptr means dead).
+		active.clear();
+		for (auto& entry : chunks)
+			active.push_back(entry.second);
+		for (SparseChunk* chunk : active)
+		{
+			for (int n = 0; n < 8; n++)
+				chunk->neighbors[n] = getChunk(chunk->x + NEIGHBOR_X[n], chunk->y + NEIGHBOR_Y[n], false);
+		}
+
+		// Chunks only read their neighbors' current cells, so they can be computed in parallel.
+		const int count = (int)active.size();
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int c = 0; c < count; c++)
+			computeChunk(active[c]);
+
+		// Swap generations, release chunks without alive cells.
+		for (SparseChunk* chunk : active)
+		{
+			uint64_t alive = 0;
+			for (int r = 0; r < 64; r++)
+			{
+				chunk->cells[r] = chunk->next[r];
+				alive |= chunk->cells[r];
+			}
+			if (alive == 0)
+			{
+				chunks.erase(chunkKey(chunk->x, chunk->y));
+				releaseChunk(chunk);
+			}
+		}
+	}
+
+	if (hasWindow)
+		return exportWindow(windowX, windowY, windowWidth, windowHeight);
+
+	int64_t minX, minY, maxX, maxY;
+	if (!boundingBox(minX, minY, maxX, maxY))
+		return exportWindow(0, 0, 1, 1);
+	return exportWindow(minX, minY, (unsigned int)(maxX - minX + 1), (unsigned int)(maxY - minY + 1));
+}
+
+void GOLSparse::computeChunk(SparseChunk* chunk)
+{
+	SparseChunk* const* n = chunk->neighbors;
+	// Rows -1 to 64 of this chunk's column: west word, own word, east word.
+	uint64_t west[66], middle[66], east[66];
+	west[0] = n[0] ? n[0]->cells[63] : 0;
+	middle[0] = n[1] ? n[1]->cells[63] : 0;
+	east[0] = n[2] ? n[2]->cells[63] : 0;
+	for (int r = 0; r < 64; r++)
+	{
+		west[r + 1] = n[3] ? n[3]->cells[r] : 0;
+		middle[r + 1] = chunk->cells[r];
+		east[r + 1] = n[4] ? n[4]->cells[r] : 0;
+	}
+	west[65] = n[5] ? n[5]->cells[0] : 0;
+	middle[65] = n[6] ? n[6]->cells[0] : 0;
+	east[65] = n[7] ? n[7]->cells[0] : 0;
+
+	// Bit x of left holds the cell at x - 1, bit x of right the cell at x + 1.
+	uint64_t left[66], right[66];
+	for (int r = 0; r < 66; r++)
+	{
+		left[r] = (middle[r] << 1) | (west[r] >> 63);
+		right[r] = (middle[r] >> 1) | (east[r] << 63);
+	}
+
+	for (int r = 0; r < 64; r++)
+		chunk->next[r] = GOLBitPacked::nextWord(left[r], middle[r], right[r], left[r + 1], middle[r + 1], right[r + 1], left[r + 2], middle[r + 2], right[r + 2]);
+}
+
+/**
+ * Copy the cells in the window into a new grid.
+ */
+Grid* GOLSparse::exportWindow(int64_t x, int64_t y, unsigned int width, unsigned int height)
+{
+	Grid* window = new Grid(width, height);
+	for (auto& entry : chunks)
+	{
+		SparseChunk* chunk = entry.second;
+		for (int r = 0; r < 64; r++)
+		{
+			int64_t cellY = chunk->y * 64 + r - y;
+			if (cellY < 0 || cellY >= height || chunk->cells[r] == 0)
+				continue;
+			bool* row = window->getRow((int)cellY);
+			for (int b = 0; b < 64; b++)
+			{
+				int64_t cellX = chunk->x * 64 + b - x;
+				if (cellX >= 0 && cellX < width && ((chunk->cells[r] >> b) & 1))
+					row[cellX] = true;
+			}
+		}
+	}
+	return window;
+}
+
+bool GOLSparse::boundingBox(int64_t& minX, int64_t& minY, int64_t& maxX, int64_t& maxY)
+{
+	bool found = false;
+	for (auto& entry : chunks)
+	{
+		SparseChunk* chunk = entry.second;
+		for (int r = 0; r < 64; r++)
+		{
+			uint64_t row = chunk->cells[r];
+			if (row == 0)
+				continue;
+			int64_t y = chunk->y * 64 + r;
+			int64_t first = chunk->x * 64, last = chunk->x * 64 + 63;
+			while (!((row >> (first - chunk->x * 64)) & 1))
+				first++;
+			while (!((row >> (last - chunk->x * 64)) & 1))
+				last--;
+			minX = found ? std::min(minX, first) : first;
+			maxX = found ? std::max(maxX, last) : last;
+			minY = found ? std::min(minY, y) : y;
+			maxY = found ? std::max(maxY, y) : y;
+			found = true;
+		}
+	}
+	return found;
+}
+
+SparseChunk* GOLSparse::getChunk(int64_t x, int64_t y, bool create)
+{
+	auto it = chunks.find(chunkKey(x, y));
+	if (it != chunks.end())
+		return it->second;
+	if (!create)
+		return nullptr;
+
+	SparseChunk* chunk;
+	if (pool.empty())
+		chunk = new SparseChunk;
+	else
+	{
+		chunk = pool.back();
+		pool.pop_back();
+	}
+	std::memset(chunk->cells, 0, sizeof(chunk->cells));
+	chunk->x = x;
+	chunk->y = y;
+	chunks[chunkKey(x, y)] = chunk;
+	return chunk;
+}
+
+void GOLSparse::releaseChunk(SparseChunk* chunk)
+{
+	pool.push_back(chunk);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include "Grid.h"
+
+// 64x64 cells, one uint64_t per row (bit x is the cell at x).
+struct SparseChunk
+{
+	uint64_t cells[64];
+	uint64_t next[64];
+	// NW, N, NE, W, E, SW, S, SE (nullptr if not allocated, i.e. dead)
+	SparseChunk* neighbors[8];
+	int64_t x;
+	int64_t y;
+};
+
+/**
+ * Unbounded plane (no wrap around). Only chunks containing alive cells are kept, in a hash map by chunk coordinate.
+ */
+class GOLSparse
+{
+public:
+	static void setup(const Grid* world);
+	// Continues from the chunks of setup (world and newWorld are not used), returns a new grid of the window or bounding box.
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations);
+	// Window to export, relative to the loaded board. Without it, the bounding box of the alive cells is exported.
+	static void setWindow(int64_t x, int64_t y, unsigned int width, unsigned int height);
+	static Grid* exportWindow(int64_t x, int64_t y, unsigned int width, unsigned int height);
+	static bool boundingBox(int64_t& minX, int64_t& minY, int64_t& maxX, int64_t& maxY);
+
+private:
+	static SparseChunk* getChunk(int64_t x, int64_t y, bool create);
+	static void releaseChunk(SparseChunk* chunk);
+	static void computeChunk(SparseChunk* chunk);
+};
@@ -0,0 +1,332 @@
+#include "GOLWorkStealing.h"
+#include "ActiveTiles.h"
+#include "Rule.h"
+#include "../util/Timing.h"
+#include <omp.h>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * Tiles [front, back) of queue, packed into one word so the owner (front) and thieves (back) only need a CAS.
+ * All tiles are queued before the threads start taking them, so the range only shrinks.
+ */
+struct alignas(64) TileQueue
+{
+	std::atomic<uint64_t> range;
+
+	void reset(uint32_t front, uint32_t back)
+	{
+		range.store((uint64_t)back << 32 | front, std::memory_order_relaxed);
+	}
+
+	int popFront(const std::vector<int>& queue)
+	{
+		uint64_t current = range.load(std::memory_order_relaxed);
+		while ((uint32_t)current < (uint32_t)(current >> 32))
+		{
+			if (range.compare_exchange_weak(current, current + 1, std::memory_order_relaxed))
+				return queue[(uint32_t)current];
+		}
+		return -1;
+	}
+
+	int popBack(const std::vector<int>& queue)
+	{
+		uint64_t current = range.load(std::memory_order_relaxed);
+		while ((uint32_t)current < (uint32_t)(current >> 32))
+		{
+			if (range.compare_exchange_weak(current, current - (1ULL << 32), std::memory_order_relaxed))
+				return queue[(uint32_t)(current >> 32) - 1];
+		}
+		return -1;
+	}
+};
+
+// Own copy of the board, pages placed by the owning threads.
+static Grid* localWorld = nullptr;
+static Grid* localNewWorld = nullptr;
+static unsigned int tileSize;
+static int tilesX;
+static int tilesY;
+
+// Processors the process may run on (threads are pinned to one of them and restored afterwards).
+#ifdef _WIN32
+static DWORD_PTR processMask = 0;
+#else
+static cpu_set_t processCpus;
+#endif
+static bool affinityKnown = false;
+
+void GOLWorkStealing::setup(const Grid* world, unsigned int size)
+{
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	tileSize = size;
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+
+	if (!affinityKnown)
+	{
+#ifdef _WIN32
+		DWORD_PTR systemMask;
+		GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+#else
+		sched_getaffinity(0, sizeof(processCpus), &processCpus);
+#endif
+		affinityKnown = true;
+	}
+
+	// Not zeroed, the first write below decides where the pages are.
+	delete localWorld;
+	delete localNewWorld;
+	localWorld = new Grid(width, height, false);
+	localNewWorld = new Grid(width, height, false);
+
+#pragma omp parallel
+	{
+		const int thread = omp_get_thread_num();
+		pinThread(thread);
+		int startY, endY;
+		bandRows(thread, omp_get_num_threads(), startY, endY);
+		// Whole rows including padding and halo; the halo rows belong to the bands of the first and last row.
+		if (startY == 0 && endY > 0)
+			startY = -1;
+		if (endY == height && startY < endY)
+			endY = height + 1;
+		const size_t stride = world->getStride();
+		for (int y = startY; y < endY; y++)
+		{
+			std::memcpy(localWorld->getRow(y) - Grid::ALIGNMENT, world->getRow(y) - Grid::ALIGNMENT, stride);
+			std::memcpy(localNewWorld->getRow(y) - Grid::ALIGNMENT, world->getRow(y) - Grid::ALIGNMENT, stride);
+		}
+		unpinThread();
+	}
+}
+
+Grid* GOLWorkStealing::runGenerations(Grid* world, Grid* /* newWorld */, unsigned int generations)
+{
+	return withActiveRule([&](auto rule) { return runGenerations(world, generations, rule); });
+}
+
+template<class CellRule>
+Grid* GOLWorkStealing::runGenerations(Grid* world, unsigned int generations, CellRule rule)
+{
+	const int width = world->getWidth();
+	const int height = world->getHeight();
+	ActiveTiles tiles(width, height, tileSize);
+	Grid* grids[2]{ localWorld, localNewWorld };
+
+	// Tiles of band b are queued in queue from the first tile of the band on.
+	std::vector<int> queue(tiles.getTileCount());
+	const int maxThreads = omp_get_max_threads();
+	TileQueue* queues = (TileQueue*)alignedAlloc(alignof(TileQueue), sizeof(TileQueue) * maxThreads);
+	for (int thread = 0; thread < maxThreads; thread++)
+		new (&queues[thread]) TileQueue;
+	std::vector<long long> computed(maxThreads, 0);
+	std::vector<long long> steals(maxThreads, 0);
+	std::vector<Timing::Duration> busy(maxThreads, Timing::Duration(0));
+	int threadCount = 1;
+
+	// Enter parallel section (once)
+#pragma omp parallel
+	{
+		const int threads = omp_get_num_threads();
+		const int thread = omp_get_thread_num();
+		pinThread(thread);
+		int startY, endY;
+		bandRows(thread, threads, startY, endY);
+		const int firstTile = (startY + tileSize - 1) / tileSize * tilesX;
+		const int endTile = (endY + tileSize - 1) / tileSize * tilesX;
+		// Counted locally, the vectors are only written once at the end (no false sharing).
+		long long ownComputed = 0;
+		long long ownSteals = 0;
+		Timing::Duration ownBusy(0);
+
+		for (unsigned int i = 0; i < generations; i++)
+		{
+			Grid* current = grids[i % 2];
+			Grid* next = grids[(i + 1) % 2];
+
+			// Left and right halo of the own rows, then top and bottom halo (including corners).
+			for (int y = startY; y < endY; y++)
+			{
+				bool* row = current->getRow(y);
+				row[-1] = row[width - 1];
+				row[width] = row[0];
+			}
+#pragma omp barrier
+			if (startY == 0 && endY > 0)
+				std::memcpy(current->getRow(-1) - 1, current->getRow(height - 1) - 1, width + 2);
+			if (endY == height && startY < endY)
+				std::memcpy(current->getRow(height) - 1, current->getRow(0) - 1, width + 2);
+
+			// Queue the tiles of the own band that need an update.
+			int count = 0;
+			for (int tile = firstTile; tile < endTile; tile++)
+			{
+				if (tiles.needsUpdate(tile % tilesX, tile / tilesX))
+					queue[firstTile + count++] = tile;
+			}
+			queues[thread].reset(firstTile, firstTile + count);
+#pragma omp barrier
+
+			// Own tiles from the front, then the other queues from the back (they only shrink, so one pass is enough).
+			auto start = std::chrono::high_resolution_clock::now();
+			int tile;
+			while ((tile = queues[thread].popFront(queue)) >= 0)
+			{
+				tiles.setChanged(tile % tilesX, tile / tilesX, processTile(current, next, tile, rule));
+				ownComputed++;
+			}
+			for (int offset = 1; offset < threads; offset++)
+			{
+				TileQueue& victim = queues[(thread + offset) % threads];
+				while ((tile = victim.popBack(queue)) >= 0)
+				{
+					tiles.setChanged(tile % tilesX, tile / tilesX, processTile(current, next, tile, rule));
+					ownComputed++;
+					ownSteals++;
+				}
+			}
+			ownBusy += std::chrono::high_resolution_clock::now() - start;
+
+#pragma omp barrier
+#pragma omp single
+			tiles.nextGeneration();
+		}
+
+		// Copy the own rows of the result.
+		const Grid* result = grids[generations % 2];
+		for (int y = startY; y < endY; y++)
+			std::memcpy(world->getRow(y), result->getRow(y), width);
+		unpinThread();
+
+		computed[thread] = ownComputed;
+		steals[thread] = ownSteals;
+		busy[thread] = ownBusy;
+		if (thread == 0)
+			threadCount = threads;
+	}
+
+	// Continue from the result on the next call.
+	localWorld = grids[generations % 2];
+	localNewWorld = grids[(generations + 1) % 2];
+	alignedFree(queues);
+
+	Timing* time = Timing::getInstance();
+	long long totalComputed = 0;
+	long long totalSteals = 0;
+	const int digits = (int)std::to_string(threadCount - 1).size();
+	for (int thread = 0; thread < threadCount; thread++)
+	{
+		std::string number = std::to_string(thread);
+		std::string name = "thread " + std::string(digits - number.size(), '0') + number;
+		time->addRecord(name + " busy", busy[thread]);
+		time->setCounter(name + " steals", steals[thread]);
+		totalComputed += computed[thread];
+		totalSteals += steals[thread];
+	}
+	long long skipped = (long long)tiles.getTileCount() * generations - totalComputed;
+	time->setCounter("active tiles", totalComputed);
+	time->setCounter("skipped tiles", skipped);
+	time->setCounter("steals", totalSteals);
+	time->setCounter("stolen tiles (%)", totalComputed > 0 ? totalSteals * 100 / totalComputed : 0);
+	return world;
+}
+
+/**
+ * Compute one tile. Returns whether any of its cells changed.
+ */
+template<class CellRule>
+bool GOLWorkStealing::processTile(const Grid* world, Grid* newWorld, int tile, CellRule rule)
+{
+	const int startX = tile % tilesX * tileSize;
+	const int startY = tile / tilesX * tileSize;
+	const int endX = std::min(startX + (int)tileSize, (int)world->getWidth());
+	const int endY = std::min(startY + (int)tileSize, (int)world->getHeight());
+	bool changed = false;
+	for (int y = startY; y < endY; y++)
+	{
+		const bool* above = world->getRow(y - 1);
+		const bool* row = world->getRow(y);
+		const bool* below = world->getRow(y + 1);
+		bool* newRow = newWorld->getRow(y);
+		for (int x = startX; x < endX; x++)
+		{
+			int neighborsAlive = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+			newRow[x] = rule(row[x], neighborsAlive);
+			changed |= newRow[x] != row[x];
+		}
+	}
+	return changed;
+}
+
+/**
+ * Rows [startY, endY) of band: whole tile rows, split evenly over the bands.
+ */
+void GOLWorkStealing::bandRows(int band, int bands, int& startY, int& endY)
+{
+	const int height = localWorld->getHeight();
+	startY = std::min(tilesY * band / bands * (int)tileSize, height);
+	endY = std::min(tilesY * (band + 1) / bands * (int)tileSize, height);
+}
+
+/**
+ * Pin the calling thread to the n-th processor of the process (wrapping around).
+ */
+bool GOLWorkStealing::pinThread(int thread)
+{
+#ifdef _WIN32
+	int count = 0;
+	for (int cpu = 0; cpu < (int)sizeof(DWORD_PTR) * 8; cpu++)
+		count += (processMask >> cpu) & 1;
+	if (count == 0)
+		return false;
+	int n = thread % count;
+	for (int cpu = 0; cpu < (int)sizeof(DWORD_PTR) * 8; cpu++)
+	{
+		if (((processMask >> cpu) & 1) && n-- == 0)
+			return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+	}
+	return false;
+#else
+	int count = CPU_COUNT(&processCpus);
+	if (count == 0)
+		return false;
+	int n = thread % count;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (CPU_ISSET(cpu, &processCpus) && n-- == 0)
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+		}
+	}
+	return false;
+#endif
+}
+
+/**
+ * Let the calling thread run on all processors of the process again (threads are shared with other engines).
+ */
+void GOLWorkStealing::unpinThread()
+{
+#ifdef _WIN32
+	SetThreadAffinityMask(GetCurrentThread(), processMask);
+#else
+	pthread_setaffinity_np(pthread_self(), sizeof(processCpus), &processCpus);
+#endif
+}
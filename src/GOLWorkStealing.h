@@ -0,0 +1,26 @@
+#pragma once
+#include "Grid.h"
+
+/**
+ * One OpenMP team for the whole run, every thread pinned to its own core and owning a band of tile rows.
+ * The engine keeps its own copy of the board whose pages are first written by the owning threads,
+ * so on NUMA systems every band lives in the memory of the socket computing it.
+ * Each generation a thread queues the tiles of its band that need an update (see ActiveTiles) and works
+ * through them from the front; threads that run out steal tiles from the back of the other queues.
+ */
+class GOLWorkStealing
+{
+public:
+	static void setup(const Grid* world, unsigned int tileSize);
+	// The result is copied into world; newWorld is not used, the engine computes on its own copy.
+	static Grid* runGenerations(Grid* world, Grid* newWorld, unsigned int generations);
+
+private:
+	template<class CellRule>
+	static Grid* runGenerations(Grid* world, unsigned int generations, CellRule rule);
+	template<class CellRule>
+	static bool processTile(const Grid* world, Grid* newWorld, int tile, CellRule rule);
+	static void bandRows(int band, int bands, int& startY, int& endY);
+	static bool pinThread(int thread);
+	static void unpinThread();
+};
@@ -0,0 +1,72 @@
+#include "Grid.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+void* alignedAlloc(size_t alignment, size_t size)
+{
+	void* memory = nullptr;
+#ifdef _WIN32
+	memory = _aligned_malloc(size, alignment);
+#else
+	if (posix_memalign(&memory, alignment, size) != 0)
+		memory = nullptr;
+#endif
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void alignedFree(void* memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+Grid::Grid(unsigned int width, unsigned int height, bool zero)
+	: mWidth(width), mHeight(height)
+{
+	// Leave ALIGNMENT cells in front of every row, the last of those is the left halo.
+	mStride = (ALIGNMENT + width + 1 + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	mOffset = mStride + ALIGNMENT;
+	mSize = mStride * (height + 2);
+
+	mData = (bool*)alignedAlloc(ALIGNMENT, mSize);
+	if (zero)
+		clear();
+}
+
+Grid::~Grid()
+{
+	alignedFree(mData);
+}
+
+/**
+ * Copy the opposite border into the halo (wrap around).
+ * Call once per generation before reading neighbors.
+ */
+void Grid::refreshHalo()
+{
+	// Left and right
+	for (unsigned int y = 0; y < mHeight; y++)
+	{
+		bool* row = getRow(y);
+		row[-1] = row[mWidth - 1];
+		row[mWidth] = row[0];
+	}
+	// Top and bottom (including corners)
+	std::memcpy(getRow(-1) - 1, getRow(mHeight - 1) - 1, mWidth + 2);
+	std::memcpy(getRow(mHeight) - 1, getRow(0) - 1, mWidth + 2);
+}
+
+void Grid::clear()
+{
+	std::memset(mData, 0, mSize);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+
+// size bytes starting at a multiple of alignment (a power of two, at least sizeof(void*)); throws std::bad_alloc.
+// Also for types declared alignas(64), which new[] only honors from C++17 on. Release with alignedFree.
+void* alignedAlloc(size_t alignment, size_t size);
+void alignedFree(void* memory);
+
+/**
+ * Contiguous world storage with a one cell halo around the board.
+ * Cell (x, y) is at getRow(y)[x], with x from -1 to width and y from -1 to height.
+ * Every row starts at a multiple of ALIGNMENT, so (0, y) is aligned for vector loads.
+ */
+class Grid
+{
+public:
+	static constexpr unsigned int ALIGNMENT = 64;
+
+	// Without zero the memory is not touched, so the threads that first write it decide where its pages are (NUMA).
+	Grid(unsigned int width, unsigned int height, bool zero = true);
+	~Grid();
+	Grid(const Grid&) = delete;
+	Grid& operator=(const Grid&) = delete;
+
+	unsigned int getWidth() const { return mWidth; }
+	unsigned int getHeight() const { return mHeight; }
+	// Distance between two rows in cells.
+	size_t getStride() const { return mStride; }
+	// Index of cell (0, 0) in the data.
+	size_t getOffset() const { return mOffset; }
+	// Number of cells including halo and padding.
+	size_t getSize() const { return mSize; }
+
+	bool* getData() { return mData; }
+	const bool* getData() const { return mData; }
+	bool* getRow(int y) { return mData + mOffset + y * (ptrdiff_t)mStride; }
+	const bool* getRow(int y) const { return mData + mOffset + y * (ptrdiff_t)mStride; }
+
+	void refreshHalo();
+	void clear();
+
+private:
+	unsigned int mWidth;
+	unsigned int mHeight;
+	size_t mStride;
+	size_t mOffset;
+	size_t mSize;
+	bool* mData;
+};
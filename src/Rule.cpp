@@ -0,0 +1,86 @@
+#include "Rule.h"
+#include <cctype>
+
+static Rule active;
+
+void Rule::setActive(const Rule& rule)
+{
+	active = rule;
+}
+
+const Rule& Rule::getActive()
+{
+	return active;
+}
+
+/**
+ * Read neighbor counts (digits 0 to 8) from position until the first other character.
+ */
+static uint16_t readCounts(const std::string& text, size_t& position)
+{
+	uint16_t counts = 0;
+	while (position < text.size() && text[position] >= '0' && text[position] <= '8')
+		counts |= 1 << (text[position++] - '0');
+	return counts;
+}
+
+bool Rule::parse(const std::string& text, Rule& rule)
+{
+	std::string upper;
+	for (char c : text)
+	{
+		if (!std::isspace((unsigned char)c))
+			upper += (char)std::toupper((unsigned char)c);
+	}
+	if (upper.empty())
+		return false;
+
+	size_t position = 0;
+	uint16_t birth, survival;
+	if (upper[0] == 'B' || upper[0] == 'S')
+	{
+		// B<counts>/S<counts> in either order, the slash is optional.
+		bool birthFirst = upper[0] == 'B';
+		position++;
+		uint16_t first = readCounts(upper, position);
+		if (position < upper.size() && upper[position] == '/')
+			position++;
+		if (position == upper.size() || upper[position] != (birthFirst ? 'S' : 'B'))
+			return false;
+		position++;
+		uint16_t second = readCounts(upper, position);
+		birth = birthFirst ? first : second;
+		survival = birthFirst ? second : first;
+	}
+	else
+	{
+		// <survival>/<birth>
+		survival = readCounts(upper, position);
+		if (position == upper.size() || upper[position] != '/')
+			return false;
+		position++;
+		birth = readCounts(upper, position);
+	}
+	if (position != upper.size())
+		return false;
+
+	rule = Rule(birth, survival);
+	return true;
+}
+
+std::string Rule::toString() const
+{
+	std::string text = "B";
+	for (int neighbors = 0; neighbors < 9; neighbors++)
+	{
+		if ((birth >> neighbors) & 1)
+			text += (char)('0' + neighbors);
+	}
+	text += "/S";
+	for (int neighbors = 0; neighbors < 9; neighbors++)
+	{
+		if ((survival >> neighbors) & 1)
+			text += (char)('0' + neighbors);
+	}
+	return text;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * Life-like rule in B/S notation, e.g. B3/S23 (Conway), B36/S23 (HighLife), B2/S (Seeds), B3678/S34678 (Day & Night).
+ * Bit n of birth (survival) is set if a dead (alive) cell with n alive neighbors is alive in the next generation.
+ */
+class Rule
+{
+public:
+	Rule() : birth(0x008), survival(0x00C) {}
+	Rule(uint16_t birth, uint16_t survival) : birth(birth), survival(survival) {}
+
+	// "B3/S23", "b3/s23" or the older "23/3" (survival first). Returns false if the text is no rule.
+	static bool parse(const std::string& text, Rule& rule);
+	std::string toString() const;
+
+	// Rule of all engines (default B3/S23).
+	static void setActive(const Rule& rule);
+	static const Rule& getActive();
+
+	bool isConway() const { return birth == 0x008 && survival == 0x00C; }
+	// Dead cells without neighbors come alive, so the board outside the pattern doesn't stay empty.
+	bool bornFromNothing() const { return (birth & 1) != 0; }
+	bool next(bool alive, int neighbors) const { return (((alive ? survival : birth) >> neighbors) & 1) != 0; }
+
+	bool operator==(const Rule& other) const { return birth == other.birth && survival == other.survival; }
+	bool operator!=(const Rule& other) const { return !(*this == other); }
+
+	uint16_t birth;
+	uint16_t survival;
+};
+
+/**
+ * Rule known at compile time. The table is a constant, so the hot loops compile to the same code as for a fixed rule.
+ */
+template<unsigned int BIRTH, unsigned int SURVIVAL>
+struct StaticRule
+{
+	static constexpr bool TABLE[2][9]{
+		{ (BIRTH >> 0) & 1, (BIRTH >> 1) & 1, (BIRTH >> 2) & 1, (BIRTH >> 3) & 1, (BIRTH >> 4) & 1, (BIRTH >> 5) & 1, (BIRTH >> 6) & 1, (BIRTH >> 7) & 1, (BIRTH >> 8) & 1 },
+		{ (SURVIVAL >> 0) & 1, (SURVIVAL >> 1) & 1, (SURVIVAL >> 2) & 1, (SURVIVAL >> 3) & 1, (SURVIVAL >> 4) & 1, (SURVIVAL >> 5) & 1, (SURVIVAL >> 6) & 1, (SURVIVAL >> 7) & 1, (SURVIVAL >> 8) & 1 }
+	};
+
+	bool operator()(bool alive, int neighbors) const { return TABLE[alive][neighbors]; }
+};
+
+template<unsigned int BIRTH, unsigned int SURVIVAL>
+constexpr bool StaticRule<BIRTH, SURVIVAL>::TABLE[2][9];
+
+/**
+ * Any other rule: the table is filled at run time.
+ */
+struct TableRule
+{
+	explicit TableRule(const Rule& rule)
+	{
+		for (int neighbors = 0; neighbors < 9; neighbors++)
+		{
+			table[0][neighbors] = rule.next(false, neighbors);
+			table[1][neighbors] = rule.next(true, neighbors);
+		}
+	}
+
+	bool operator()(bool alive, int neighbors) const { return table[alive][neighbors]; }
+
+	bool table[2][9];
+};
+
+/**
+ * Call function with the active rule as StaticRule if it is a common one, otherwise as TableRule.
+ * The function is instantiated once per rule type, e.g. a generic lambda around a templated kernel.
+ */
+template<class Function>
+auto withActiveRule(Function function) -> decltype(function(TableRule(Rule())))
+{
+	const Rule& rule = Rule::getActive();
+	// B3/S23 Conway
+	if (rule == Rule(0x008, 0x00C))
+		return function(StaticRule<0x008, 0x00C>());
+	// B36/S23 HighLife
+	if (rule == Rule(0x048, 0x00C))
+		return function(StaticRule<0x048, 0x00C>());
+	// B2/S Seeds
+	if (rule == Rule(0x004, 0x000))
+		return function(StaticRule<0x004, 0x000>());
+	// B3678/S34678 Day & Night
+	if (rule == Rule(0x1C8, 0x1D8))
+		return function(StaticRule<0x1C8, 0x1D8>());
+	return function(TableRule(rule));
+}
@@ -0,0 +1,99 @@
+#include "SnapshotWriter.h"
+#include "GOLFile.h"
+#include <cstring>
+#include <omp.h>
+
+SnapshotWriter::SnapshotWriter(unsigned int width, unsigned int height, const std::string& pattern)
+	: mPattern(pattern)
+{
+	mStaging[0] = new Grid(width, height);
+	mStaging[1] = new Grid(width, height);
+	mThread = std::thread(&SnapshotWriter::run, this);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	finish();
+	delete mStaging[0];
+	delete mStaging[1];
+}
+
+void SnapshotWriter::capture(const Grid* world, unsigned int generation)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	Grid* staging = mStaging[mFill];
+	{
+		// Wait for the writer if both grids are still being saved.
+		std::unique_lock<std::mutex> lock(mMutex);
+		mCondition.wait(lock, [&] { return !mFull[mFill]; });
+	}
+
+	std::memcpy(staging->getData(), world->getData(), world->getSize());
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mGeneration[mFill] = generation;
+		mFull[mFill] = true;
+	}
+	mCondition.notify_all();
+	mFill = 1 - mFill;
+	mCount++;
+	mCaptureTime += std::chrono::high_resolution_clock::now() - start;
+}
+
+bool SnapshotWriter::finish()
+{
+	if (mThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mCondition.notify_all();
+		mThread.join();
+	}
+	return mFailedPath.empty();
+}
+
+void SnapshotWriter::run()
+{
+	// Formatting stays on this thread, the engine keeps all others.
+	omp_set_num_threads(1);
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true)
+	{
+		mCondition.wait(lock, [&] { return mFull[mSave] || mStop; });
+		if (!mFull[mSave])
+			return;
+
+		// Save without holding the lock, capture() fills the other grid meanwhile.
+		lock.unlock();
+		auto start = std::chrono::high_resolution_clock::now();
+		std::string path = getPath(mPattern, mGeneration[mSave]);
+		bool saved = GOLFile::save(path, mStaging[mSave]);
+		mWriteTime += std::chrono::high_resolution_clock::now() - start;
+		lock.lock();
+
+		if (!saved && mFailedPath.empty())
+			mFailedPath = path;
+		mFull[mSave] = false;
+		mSave = 1 - mSave;
+		mCondition.notify_all();
+	}
+}
+
+std::string SnapshotWriter::getPath(const std::string& pattern, unsigned int generation)
+{
+	const std::string placeholder = "{generation}";
+	std::string path = pattern;
+	size_t position = path.find(placeholder);
+	if (position != std::string::npos)
+		return path.replace(position, placeholder.size(), std::to_string(generation));
+
+	// No placeholder: before the extension (if the last path component has one).
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		dot = path.size();
+	return path.insert(dot, "_" + std::to_string(generation));
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "Grid.h"
+
+/**
+ * Saves boards of a running simulation in the background.
+ * capture() only copies the board into one of two staging grids (it waits if both are still being saved),
+ * a writer thread saves them with GOLFile in the order they were captured.
+ */
+class SnapshotWriter
+{
+public:
+	SnapshotWriter(unsigned int width, unsigned int height, const std::string& pattern);
+	~SnapshotWriter();
+	SnapshotWriter(const SnapshotWriter&) = delete;
+	SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+	void capture(const Grid* world, unsigned int generation);
+	// Wait until every snapshot is saved, false if one could not be written.
+	bool finish();
+
+	// Pattern with "{generation}" replaced (or "_<generation>" added before the extension).
+	static std::string getPath(const std::string& pattern, unsigned int generation);
+
+	unsigned int getCount() const { return mCount; }
+	const std::string& getFailedPath() const { return mFailedPath; }
+	// Time spent in capture() and time the writer thread spent saving.
+	std::chrono::duration<double, std::milli> getCaptureTime() const { return mCaptureTime; }
+	std::chrono::duration<double, std::milli> getWriteTime() const { return mWriteTime; }
+
+private:
+	void run();
+
+	std::string mPattern;
+	Grid* mStaging[2];
+	unsigned int mGeneration[2];
+	bool mFull[2] = {false, false};
+	// Next staging grid to fill and to save.
+	int mFill = 0;
+	int mSave = 0;
+	bool mStop = false;
+
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::thread mThread;
+
+	unsigned int mCount = 0;
+	std::string mFailedPath;
+	std::chrono::duration<double, std::milli> mCaptureTime{0};
+	std::chrono::duration<double, std::milli> mWriteTime{0};
+};
@@ -0,0 +1,111 @@
+#include "TuningProfile.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+std::string TuningProfile::defaultPath()
+{
+	std::string host;
+#ifdef _WIN32
+	char name[MAX_COMPUTERNAME_LENGTH + 1];
+	DWORD size = sizeof(name);
+	if (GetComputerNameA(name, &size))
+		host.assign(name, size);
+#else
+	char name[256] = {};
+	if (gethostname(name, sizeof(name) - 1) == 0)
+		host = name;
+#endif
+	if (host.empty())
+		host = "localhost";
+	return "gol_profile_" + host + ".txt";
+}
+
+bool TuningProfile::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+	mEntries.clear();
+	mInvalidLines.clear();
+	std::string line;
+	unsigned int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream fields(line);
+		Entry entry;
+		char separator, groupSeparator;
+		if (fields >> entry.width >> separator >> entry.height >> entry.rule >> entry.mode >> entry.threads >> entry.tileSize >> entry.tileDepth
+			>> entry.workGroupWidth >> groupSeparator >> entry.workGroupHeight >> entry.oclDepth >> entry.millisecondsPerGeneration
+			&& separator == 'x' && groupSeparator == 'x' && entry.width > 0 && entry.height > 0)
+			mEntries.push_back(entry);
+		else
+		{
+			std::cerr << path << ":" << lineNumber << ": cannot parse profile entry, it is kept but not used." << std::endl;
+			mInvalidLines.push_back(line);
+		}
+	}
+	return true;
+}
+
+bool TuningProfile::save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+	file << "# <width>x<height> <rule> <mode> <threads> <tile size> <tile depth> <work-group> <ocl depth> <ms per generation>" << std::endl;
+	for (const Entry& entry : mEntries)
+	{
+		file << entry.width << "x" << entry.height << " " << entry.rule << " " << entry.mode << " " << entry.threads << " " << entry.tileSize << " "
+			<< entry.tileDepth << " " << entry.workGroupWidth << "x" << entry.workGroupHeight << " " << entry.oclDepth << " " << entry.millisecondsPerGeneration << std::endl;
+	}
+	for (const std::string& line : mInvalidLines)
+		file << line << std::endl;
+	return file.good();
+}
+
+void TuningProfile::store(const Entry& entry)
+{
+	for (Entry& existing : mEntries)
+	{
+		if (existing.width == entry.width && existing.height == entry.height && existing.rule == entry.rule)
+		{
+			existing = entry;
+			return;
+		}
+	}
+	mEntries.push_back(entry);
+}
+
+const TuningProfile::Entry* TuningProfile::find(unsigned int width, unsigned int height, const std::string& rule) const
+{
+	// Distances on a log scale: 1000x1000 is as far from 500x500 as from 2000x2000.
+	const Entry* best = nullptr;
+	double bestCells = 0, bestAspect = 0;
+	for (const Entry& entry : mEntries)
+	{
+		if (entry.rule != rule)
+			continue;
+		double cells = std::abs(std::log((double)entry.width * entry.height / ((double)width * height)));
+		double aspect = std::abs(std::log((double)entry.width / entry.height * height / width));
+		if (best == nullptr || cells < bestCells || (cells == bestCells && aspect < bestAspect))
+		{
+			best = &entry;
+			bestCells = cells;
+			bestAspect = aspect;
+		}
+	}
+	return best;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/**
+ * Fastest configuration per board size and rule, found by --autotune and used by --mode auto.
+ * One line per entry (lines starting with # are comments):
+ *   <width>x<height> <rule> <mode> <threads> <tile size> <tile depth> <work-group width>x<height> <ocl depth> <ms per generation>
+ */
+class TuningProfile
+{
+public:
+	struct Entry
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::string rule;
+		std::string mode;
+		unsigned int threads = 0;
+		unsigned int tileSize = 0;
+		unsigned int tileDepth = 0;
+		unsigned int workGroupWidth = 0;
+		unsigned int workGroupHeight = 0;
+		unsigned int oclDepth = 0;
+		double millisecondsPerGeneration = 0;
+	};
+
+	// Profile of this host (the host name is part of the file name), in the working directory.
+	static std::string defaultPath();
+
+	// False if the file cannot be read; lines that cannot be parsed are reported and written back unchanged by save.
+	bool load(const std::string& path);
+	bool save(const std::string& path) const;
+
+	// Replaces the entry of the same size and rule.
+	void store(const Entry& entry);
+	// Entry of the same rule whose size is closest (cell count first, then aspect ratio), nullptr if there is none.
+	const Entry* find(unsigned int width, unsigned int height, const std::string& rule) const;
+
+private:
+	std::vector<Entry> mEntries;
+	std::vector<std::string> mInvalidLines;
+};
@@ -1,19 +1,47 @@
 #include <stdio.h>
 #include <iostream>
 #include <sstream>
+#include <cmath>
+#include <algorithm>
 #include "Timing.h"
 
-Timing* Timing::mInstance = 0;
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Paths of the open scopes of this thread, innermost last.
+static thread_local std::vector<std::string> openScopes;
 
 /**
- * Singleton: Get instance.
+ * Singleton: Get instance (created on first use, thread-safe).
  */
 Timing* Timing::getInstance() {
-	if (mInstance == 0) {
-		mInstance = new Timing();
-	}
+	static Timing instance;
+	return &instance;
+}
+
+/**
+ * Start measuring a scope below the innermost open scope of this thread or the running phase.
+ */
+Timing::Scope::Scope(const std::string& name, bool histogram) : mHistogram(histogram) {
+	std::string parent = openScopes.empty() ? Timing::getInstance()->currentPhase() : openScopes.back();
+	mPath = parent.empty() ? name : parent + "/" + name;
+	openScopes.push_back(mPath);
+	mStart = std::chrono::high_resolution_clock::now();
+}
 
-	return mInstance;
+/**
+ * Stop measuring and add the time to the record (and histogram).
+ */
+Timing::Scope::~Scope() {
+	Duration duration = std::chrono::high_resolution_clock::now() - mStart;
+	openScopes.pop_back();
+	Timing::getInstance()->addRecord(mPath, duration);
+	if (mHistogram) {
+		Timing::getInstance()->addSample(mPath, duration);
+	}
 }
 
 /**
@@ -21,6 +49,7 @@ Timing* Timing::getInstance() {
  */
 void Timing::startRecord(const std::string& name) {
 	auto start = std::chrono::high_resolution_clock::now();
+	std::lock_guard<std::mutex> lock(mMutex);
 
 	auto it = mRecordings.find(name);
 	if (it != mRecordings.end()) {
@@ -33,18 +62,150 @@ void Timing::startRecord(const std::string& name) {
 
 /**
  * Stop recording time with any name.
+ * Repeated start/stop pairs with the same name are summed up.
  */
 void Timing::stopRecord(const std::string& name) {
 	auto end = std::chrono::high_resolution_clock::now();
+	std::lock_guard<std::mutex> lock(mMutex);
 
 	auto it = mRecordings.find(name);
 	if (it != mRecordings.end()) {
-		auto start = it->second;
-		auto result = end - start;
+		Record& record = mResults[name];
+		record.total += end - it->second;
+		record.count++;
+		mRecordings.erase(it);
+	}
+
+}
+
+/**
+ * Add a duration measured elsewhere (e.g. summed up over many intervals or on another thread).
+ */
+void Timing::addRecord(const std::string& name, Duration duration) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	Record& record = mResults[name];
+	record.total += duration;
+	record.count++;
+}
+
+/**
+ * Add a sample (e.g. the time of one generation) to the histogram with the given name.
+ */
+void Timing::addSample(const std::string& name, Duration duration) {
+	double microseconds = duration.count() * 1000;
+	int bucket = microseconds < 1 ? 0 : std::min(HISTOGRAM_BUCKETS - 1, (int) std::log2(microseconds) + 1);
 
-		mResults.insert(std::pair<std::string, std::chrono::duration<double, std::milli> >(name, result));
+	std::lock_guard<std::mutex> lock(mMutex);
+	Histogram& histogram = mHistograms[name];
+	histogram.buckets[bucket]++;
+	if (histogram.count == 0 || duration < histogram.min) {
+		histogram.min = duration;
 	}
+	if (histogram.count == 0 || duration > histogram.max) {
+		histogram.max = duration;
+	}
+	histogram.count++;
+	histogram.total += duration;
+}
+
+/**
+ * Set a counter (e.g. work done or skipped) reported next to the times.
+ */
+void Timing::setCounter(const std::string& name, long long value) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCounters[name] = value;
+}
+
+/**
+ * Count cycles, instructions and last level cache misses of this process per phase (Linux perf_event_open).
+ * Must be called before threads are started: only threads created afterwards are counted.
+ * Returns false if the counters are not available (other systems, no permission, virtual machines).
+ */
+bool Timing::enableHardwareCounters() {
+#ifdef __linux__
+	std::lock_guard<std::mutex> lock(mMutex);
+	const unsigned long long events[HARDWARE_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+	};
+	for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+		perf_event_attr attributes = {};
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.size = sizeof(attributes);
+		attributes.config = events[i];
+		attributes.inherit = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+
+		mHardwareFiles[i] = (int) syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+		if (mHardwareFiles[i] < 0) {
+			for (int j = 0; j <= i; j++) {
+				if (mHardwareFiles[j] >= 0) {
+					close(mHardwareFiles[j]);
+				}
+				mHardwareFiles[j] = -1;
+			}
+			return false;
+		}
+	}
+	mHardwareEnabled = true;
+	return true;
+#else
+	return false;
+#endif
+}
 
+/**
+ * Current values of the hardware counters (including all threads created after enabling them).
+ */
+Timing::HardwareCounters Timing::readHardwareCounters() const {
+	HardwareCounters counters;
+#ifdef __linux__
+	for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+		unsigned long long value = 0;
+		if (read(mHardwareFiles[i], &value, sizeof(value)) == sizeof(value)) {
+			counters.values[i] = (long long) value;
+		}
+	}
+#endif
+	return counters;
+}
+
+/**
+ * Name of the running phase (empty between phases).
+ */
+std::string Timing::currentPhase() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mPhase;
+}
+
+/**
+ * Start a phase: record its time, make it the parent of new scopes and remember the hardware counters.
+ */
+void Timing::startPhase(const std::string& name) {
+	this->startRecord(name);
+	std::lock_guard<std::mutex> lock(mMutex);
+	mPhase = name;
+	if (mHardwareEnabled) {
+		mPhaseStart = readHardwareCounters();
+	}
+}
+
+/**
+ * Stop a phase: record its time and the hardware counters since its start.
+ */
+void Timing::stopPhase(const std::string& name) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mHardwareEnabled) {
+			HardwareCounters end = readHardwareCounters();
+			HardwareCounters& phase = mHardware[name];
+			for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+				phase.values[i] += end.values[i] - mPhaseStart.values[i];
+			}
+		}
+		mPhase.clear();
+	}
+	this->stopRecord(name);
 }
 
 /**
@@ -52,21 +213,105 @@ void Timing::stopRecord(const std::string& name) {
  * Set prettyPrint to true to display mm:ss.ms instead of ms.
  */
 void Timing::print(const bool prettyPrint) const {
+	std::lock_guard<std::mutex> lock(mMutex);
 	std::cout << "-----" << std::endl << "Results: " << std::endl << "-----" << std::endl;
 
 	auto it = mResults.begin();
 	while(it != mResults.end()) {
 		if (prettyPrint) {
-			std::cout << it->first << ": " << parseDate((int) it->second.count()) << std::endl;
+			std::cout << it->first << ": " << parseDate((int) it->second.total.count());
 		} else {
-			std::cout << it->first << ": " << it->second.count() << "ms" << std::endl;
+			std::cout << it->first << ": " << it->second.total.count() << "ms";
+		}
+		if (it->second.count > 1) {
+			std::cout << " (" << it->second.count << "x)";
 		}
+		std::cout << std::endl;
 		it++;
 	}
 
+	for (auto counter = mCounters.begin(); counter != mCounters.end(); counter++) {
+		std::cout << counter->first << ": " << counter->second << std::endl;
+	}
+
+	for (auto histogram = mHistograms.begin(); histogram != mHistograms.end(); histogram++) {
+		const Histogram& values = histogram->second;
+		std::cout << histogram->first << " latency: " << values.count << " samples, mean " << values.total.count() / values.count
+			<< "ms, min " << values.min.count() << "ms, max " << values.max.count() << "ms, p50 < " << histogramPercentile(values, 0.5)
+			<< "ms, p99 < " << histogramPercentile(values, 0.99) << "ms" << std::endl;
+	}
+
+	for (auto phase = mHardware.begin(); phase != mHardware.end(); phase++) {
+		const long long* values = phase->second.values;
+		std::cout << phase->first << " hardware: " << values[0] << " cycles, " << values[1] << " instructions ("
+			<< (values[0] > 0 ? (double) values[1] / values[0] : 0) << " per cycle), " << values[2] << " LLC misses ("
+			<< (values[1] > 0 ? values[2] * 1000.0 / values[1] : 0) << " per 1000 instructions)" << std::endl;
+	}
+
 	std::cout << "-----" << std::endl;
 }
 
+/**
+ * Upper bound (ms) of the histogram bucket that contains the given fraction of all samples.
+ */
+double Timing::histogramPercentile(const Histogram& histogram, double fraction) const {
+	long long needed = (long long) std::ceil(fraction * histogram.count);
+	long long seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += histogram.buckets[i];
+		if (seen >= needed) {
+			return std::ldexp(1.0, i) / 1000;
+		}
+	}
+	return histogram.max.count();
+}
+
+/**
+ * Write all records, counters, histograms and hardware counters as JSON.
+ * Instructions per cycle and LLC misses per 1000 instructions tell compute-bound (high IPC, few misses)
+ * from memory-bound phases.
+ */
+void Timing::writeJSON(std::ostream& output) const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	output << "{\n  \"records\": {";
+	for (auto it = mResults.begin(); it != mResults.end(); it++) {
+		output << (it == mResults.begin() ? "\n" : ",\n") << "    \"" << it->first << "\": {\"ms\": " << it->second.total.count()
+			<< ", \"count\": " << it->second.count << "}";
+	}
+
+	output << "\n  },\n  \"counters\": {";
+	for (auto it = mCounters.begin(); it != mCounters.end(); it++) {
+		output << (it == mCounters.begin() ? "\n" : ",\n") << "    \"" << it->first << "\": " << it->second;
+	}
+
+	output << "\n  },\n  \"histograms\": {";
+	for (auto it = mHistograms.begin(); it != mHistograms.end(); it++) {
+		const Histogram& values = it->second;
+		output << (it == mHistograms.begin() ? "\n" : ",\n") << "    \"" << it->first << "\": {\"count\": " << values.count
+			<< ", \"mean_ms\": " << values.total.count() / values.count << ", \"min_ms\": " << values.min.count()
+			<< ", \"max_ms\": " << values.max.count() << ", \"p50_ms\": " << histogramPercentile(values, 0.5)
+			<< ", \"p99_ms\": " << histogramPercentile(values, 0.99) << ", \"bucket_upper_us\": [";
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+			output << (i == 0 ? "" : ", ") << std::ldexp(1.0, i);
+		}
+		output << "], \"buckets\": [";
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+			output << (i == 0 ? "" : ", ") << values.buckets[i];
+		}
+		output << "]}";
+	}
+
+	output << "\n  },\n  \"hardware\": {";
+	for (auto it = mHardware.begin(); it != mHardware.end(); it++) {
+		const long long* values = it->second.values;
+		output << (it == mHardware.begin() ? "\n" : ",\n") << "    \"" << it->first << "\": {\"cycles\": " << values[0]
+			<< ", \"instructions\": " << values[1] << ", \"llc_misses\": " << values[2]
+			<< ", \"instructions_per_cycle\": " << (values[0] > 0 ? (double) values[1] / values[0] : 0)
+			<< ", \"llc_misses_per_kilo_instruction\": " << (values[1] > 0 ? values[2] * 1000.0 / values[1] : 0) << "}";
+	}
+	output << "\n  }\n}" << std::endl;
+}
+
 /**
  * Parse date from ms to mm:ss.ms.
  */
@@ -100,21 +345,22 @@ std::string Timing::parseDate(const int ms) const {
  * mm:ss.ms;mm:ss.ms;mm.ss.ms
  */
 std::string Timing::getResults() const {
+	std::lock_guard<std::mutex> lock(mMutex);
 	std::ostringstream stringStream;
 
 	auto start = mResults.find("setup");
 	if (start != mResults.end()) {
-		stringStream << parseDate((int) start->second.count()) << ";";
+		stringStream << parseDate((int) start->second.total.count()) << ";";
 	}
 
 	auto computation = mResults.find("computation");
 	if (computation != mResults.end()) {
-		stringStream << parseDate((int) computation->second.count()) << ";";
+		stringStream << parseDate((int) computation->second.total.count()) << ";";
 	}
 
 	auto finalization = mResults.find("finalization");
-	if (start != mResults.end()) {
-		stringStream << parseDate((int) finalization->second.count());
+	if (finalization != mResults.end()) {
+		stringStream << parseDate((int) finalization->second.total.count());
 	}
 
 	return stringStream.str();
@@ -124,40 +370,40 @@ std::string Timing::getResults() const {
  * Start recording the setup time.
  */
 void Timing::startSetup() {
-	this->startRecord("setup");
+	this->startPhase("setup");
 }
 
 /**
  * Stop recording the setup time.
  */
 void Timing::stopSetup() {
-	this->stopRecord("setup");
+	this->stopPhase("setup");
 }
 
 /**
  * Start recording the computation time.
  */
 void Timing::startComputation() {
-	this->startRecord("computation");
+	this->startPhase("computation");
 }
 
 /**
  * Stop recording the computation time.
  */
 void Timing::stopComputation() {
-	this->stopRecord("computation");
+	this->stopPhase("computation");
 }
 
 /**
  * Start recording the finalization time.
  */
 void Timing::startFinalization() {
-	this->startRecord("finalization");
+	this->startPhase("finalization");
 }
 
 /**
  * Stop recording the finalization time.
  */
 void Timing::stopFinalization() {
-	this->stopRecord("finalization");
+	this->stopPhase("finalization");
 }
\ No newline at end of file
@@ -2,13 +2,37 @@
 #include <chrono>
 #include <string>
 #include <map>
+#include <vector>
+#include <mutex>
+#include <ostream>
 
 /**
  * Measure high precision time intervals (using std::chrono).
+ * All methods are thread-safe; Scope can be used from OpenMP threads.
  * Author: Karl Hofer <hoferk@technikum-wien.at>
  */
 class Timing {
 public:
+	typedef std::chrono::duration<double, std::milli> Duration;
+
+	/**
+	 * Measures its own lifetime and adds it to the record "<parent>/<name>". The parent is the enclosing
+	 * Scope of the same thread, otherwise the running phase (setup, computation or finalization).
+	 * With histogram set, every lifetime is also a sample of the histogram with the same name.
+	 */
+	class Scope {
+	public:
+		explicit Scope(const std::string& name, bool histogram = false);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		std::string mPath;
+		bool mHistogram;
+		std::chrono::high_resolution_clock::time_point mStart;
+	};
+
 	static Timing* getInstance();
 
 	void startSetup();
@@ -20,14 +44,55 @@ public:
 
 	void startRecord(const std::string& name);
 	void stopRecord(const std::string& name);
+	void addRecord(const std::string& name, Duration duration);
+	void addSample(const std::string& name, Duration duration);
+	void setCounter(const std::string& name, long long value);
+	bool enableHardwareCounters();
 	void print(const bool prettyPrint = false) const;
 	std::string getResults() const;
+	void writeJSON(std::ostream& output) const;
 
 private:
+	// Sum of all intervals with the same name.
+	struct Record {
+		Duration total{0};
+		long long count = 0;
+	};
+
+	// Bucket 0 holds samples below 1us, bucket i samples from 2^(i-1)us to below 2^i us.
+	static const int HISTOGRAM_BUCKETS = 32;
+	struct Histogram {
+		std::vector<long long> buckets = std::vector<long long>(HISTOGRAM_BUCKETS, 0);
+		long long count = 0;
+		Duration total{0};
+		Duration min{0};
+		Duration max{0};
+	};
+
+	// Cycles, instructions and last level cache misses (perf_event_open, Linux only).
+	static const int HARDWARE_COUNTERS = 3;
+	struct HardwareCounters {
+		long long values[HARDWARE_COUNTERS] = {0, 0, 0};
+	};
+
 	Timing() {};
+	void startPhase(const std::string& name);
+	void stopPhase(const std::string& name);
+	HardwareCounters readHardwareCounters() const;
+	double histogramPercentile(const Histogram& histogram, double fraction) const;
+	std::string currentPhase() const;
+
+	mutable std::mutex mMutex;
 	std::map<std::string, std::chrono::high_resolution_clock::time_point > mRecordings;
-	std::map<std::string, std::chrono::duration<double, std::milli> > mResults;
-	std::string parseDate(const int ms) const;
+	std::map<std::string, Record> mResults;
+	std::map<std::string, long long> mCounters;
+	std::map<std::string, Histogram> mHistograms;
+	std::string mPhase;
 
-	static Timing* mInstance;
+	bool mHardwareEnabled = false;
+	int mHardwareFiles[HARDWARE_COUNTERS] = {-1, -1, -1};
+	HardwareCounters mPhaseStart;
+	std::map<std::string, HardwareCounters> mHardware;
+
+	std::string parseDate(const int ms) const;
 };